@@ -0,0 +1,611 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcfreader.h"
+
+// size of the buffers for compressed and decompressed data
+#define BCF_INBUFSIZE  1048576
+#define BCF_BUFSIZE    4194304
+
+// missing float and end of vector
+#define BCF_FLOAT_MISSING    0x7F800001u
+#define BCF_FLOAT_VECTOR_END 0x7F800002u
+
+// value classification
+#define VAL_OK      0
+#define VAL_MISSING 1
+#define VAL_END     2
+
+static void strGrow(BcfStr* s, size_t add) {
+    if (s->l + add + 1 > s->m) {
+        s->m = 2 * (s->l + add + 1);
+        s->s = realloc(s->s, s->m);
+    }
+}
+
+void bcfStrAppend(BcfStr* s, const char* c, size_t n) {
+    strGrow(s, n);
+    memcpy(s->s + s->l, c, n);
+    s->l += n;
+    s->s[s->l] = '\0';
+}
+
+#define strAppend bcfStrAppend
+
+static inline void strPut(BcfStr* s, char c) {
+    strGrow(s, 1);
+    s->s[s->l++] = c;
+    s->s[s->l] = '\0';
+}
+
+// writes an unsigned integer to o, returns the end
+static inline char* putUInt(char* o, uint32_t v) {
+    if (v < 10) { // most frequent case for allele indices
+        *o++ = '0' + v;
+        return o;
+    }
+    char b[10];
+    int n = 0;
+    for (; v; v /= 10)
+        b[n++] = '0' + v % 10;
+    while (n)
+        *o++ = b[--n];
+    return o;
+}
+
+static inline void strPutInt(BcfStr* s, int64_t v) {
+    strGrow(s, 12);
+    char* o = s->s + s->l;
+    if (v < 0) {
+        *o++ = '-';
+        v = -v;
+    }
+    o = putUInt(o, (uint32_t) v);
+    *o = '\0';
+    s->l = o - s->s;
+}
+
+// shortest representation of a float that reads back to the same value
+static inline void strPutFloat(BcfStr* s, float f) {
+    char b[32];
+    int n = 0;
+    for (int p = 6; p <= 9; p++) {
+        n = snprintf(b, sizeof(b), "%.*g", p, f);
+        if (strtof(b, NULL) == f)
+            break;
+    }
+    strAppend(s, b, n);
+}
+
+static inline uint32_t getLE32(const unsigned char* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline size_t typeSize(int type) {
+    switch (type) {
+    case BCF_BT_INT16: return 2;
+    case BCF_BT_INT32:
+    case BCF_BT_FLOAT: return 4;
+    case BCF_BT_NULL:  return 0;
+    default:           return 1;
+    }
+}
+
+// integer value of the given type, the class (ok, missing, end of vector) is returned in cls
+static inline int32_t getInt(const unsigned char* p, int type, int* cls) {
+    int32_t v;
+    *cls = VAL_OK;
+    if (type == BCF_BT_INT8) {
+        v = (int8_t) p[0];
+        if (v == INT8_MIN)
+            *cls = VAL_MISSING;
+        else if (v == INT8_MIN+1)
+            *cls = VAL_END;
+    } else if (type == BCF_BT_INT16) {
+        v = (int16_t) (p[0] | (p[1] << 8));
+        if (v == INT16_MIN)
+            *cls = VAL_MISSING;
+        else if (v == INT16_MIN+1)
+            *cls = VAL_END;
+    } else {
+        v = (int32_t) getLE32(p);
+        if (v == INT32_MIN)
+            *cls = VAL_MISSING;
+        else if (v == INT32_MIN+1)
+            *cls = VAL_END;
+    }
+    return v;
+}
+
+// reads the type and number of elements of a typed value at p, returns a pointer to the data
+static const unsigned char* typedHeader(const unsigned char* p, int* type, size_t* n) {
+    *type = *p & 0xf;
+    *n = *p >> 4;
+    p++;
+    if (*n == 15) { // length follows as typed integer
+        int t = *p & 0xf;
+        int cls;
+        *n = getInt(p+1, t, &cls);
+        p += 1 + typeSize(t);
+    }
+    return p;
+}
+
+// formats a vector of n values as comma separated text (stops at the end of the vector)
+static void formatValues(BcfStr* s, const unsigned char* p, int type, size_t n) {
+    if (type == BCF_BT_CHAR) {
+        size_t l = 0;
+        while (l < n && p[l] != '\0')
+            l++;
+        if (l == 0)
+            strPut(s, '.');
+        else
+            strAppend(s, (const char*) p, l);
+        return;
+    }
+    size_t sz = typeSize(type);
+    size_t i = 0;
+    if (type == BCF_BT_FLOAT) {
+        for (; i < n; i++, p += sz) {
+            uint32_t u = getLE32(p);
+            if (u == BCF_FLOAT_VECTOR_END)
+                break;
+            if (i)
+                strPut(s, ',');
+            if (u == BCF_FLOAT_MISSING)
+                strPut(s, '.');
+            else {
+                float f;
+                memcpy(&f, &u, 4);
+                strPutFloat(s, f);
+            }
+        }
+    } else {
+        strGrow(s, n * 12 + 1);
+        char* o = s->s + s->l;
+        for (; i < n; i++, p += sz) {
+            int cls;
+            int32_t v = getInt(p, type, &cls);
+            if (cls == VAL_END)
+                break;
+            if (i)
+                *o++ = ',';
+            if (cls == VAL_MISSING)
+                *o++ = '.';
+            else {
+                if (v < 0) {
+                    *o++ = '-';
+                    v = -v;
+                }
+                o = putUInt(o, v);
+            }
+        }
+        *o = '\0';
+        s->l = o - s->s;
+    }
+    if (i == 0) // empty vector
+        strPut(s, '.');
+}
+
+// formats a genotype
+static void formatGT(BcfStr* s, const unsigned char* p, int type, size_t n) {
+    strGrow(s, n * 12 + 1);
+    char* o = s->s + s->l;
+    size_t sz = typeSize(type);
+    size_t i = 0;
+    for (; i < n; i++, p += sz) {
+        int cls;
+        int32_t v = getInt(p, type, &cls);
+        if (cls == VAL_END)
+            break;
+        if (i)
+            *o++ = (v & 1) ? '|' : '/';
+        if (cls == VAL_MISSING || (v >> 1) == 0)
+            *o++ = '.';
+        else
+            o = putUInt(o, (v >> 1) - 1);
+    }
+    if (i == 0)
+        *o++ = '.';
+    *o = '\0';
+    s->l = o - s->s;
+}
+
+// reads n bytes of the decompressed stream, returns the number of bytes read
+static size_t readBytes(BcfReader* r, void* dst, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        if (r->bufpos == r->buflen) { // refill
+            r->bufpos = 0;
+            r->buflen = 0;
+            if (!r->compressed) {
+                r->buflen = fread(r->buf, 1, BCF_BUFSIZE, r->in);
+                if (r->buflen == 0)
+                    break;
+            } else {
+                while (r->buflen == 0) {
+                    if (r->zs.avail_in == 0) {
+                        r->zs.avail_in = fread(r->inbuf, 1, BCF_INBUFSIZE, r->in);
+                        r->zs.next_in = r->inbuf;
+                        if (r->zs.avail_in == 0)
+                            return done;
+                    }
+                    r->zs.next_out = r->buf;
+                    r->zs.avail_out = BCF_BUFSIZE;
+                    int ret = inflate(&r->zs, Z_NO_FLUSH);
+                    if (ret == Z_STREAM_END) // end of a BGZF block, the next one follows
+                        inflateReset(&r->zs);
+                    else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                        fprintf(stderr, "ERROR: Failed to decompress the BCF input.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    r->buflen = BCF_BUFSIZE - r->zs.avail_out;
+                }
+            }
+        }
+        size_t k = r->buflen - r->bufpos;
+        if (k > n - done)
+            k = n - done;
+        memcpy((char*) dst + done, r->buf + r->bufpos, k);
+        r->bufpos += k;
+        done += k;
+    }
+    return done;
+}
+
+// adds a name to a dictionary at the given index
+static void dictSet(char*** dict, size_t* ndict, size_t idx, const char* name, size_t len) {
+    if (idx >= *ndict) {
+        *dict = realloc(*dict, (idx+1) * sizeof(char*));
+        memset(*dict + *ndict, 0, (idx+1 - *ndict) * sizeof(char*));
+        *ndict = idx+1;
+    }
+    if ((*dict)[idx] == NULL) {
+        (*dict)[idx] = malloc(len+1);
+        memcpy((*dict)[idx], name, len);
+        (*dict)[idx][len] = '\0';
+    }
+}
+
+// returns the value of the attribute IDX of a structured header line or -1 if not present
+static long headerIDX(const char* l, const char* lend) {
+    for (const char* p = l; p + 5 < lend; p++) {
+        if (*p == '"') { // skip quoted text
+            for (p++; p < lend && *p != '"'; p++)
+                if (*p == '\\')
+                    p++;
+            continue;
+        }
+        if ((*p == ',' || *p == '<') && strncmp(p+1, "IDX=", 4) == 0)
+            return strtol(p+5, NULL, 10);
+    }
+    return -1;
+}
+
+// builds the dictionaries from the header text (in the same way htslib does)
+static void parseHeader(BcfReader* r) {
+    size_t next = 1;
+    size_t nextcontig = 0;
+    dictSet(&r->ids, &r->nids, 0, "PASS", 4); // PASS is always the first filter
+    for (char* l = r->hdr; l < r->hdr + r->hdrlen; ) {
+        char* lend = strchr(l, '\n');
+        if (lend == NULL)
+            lend = r->hdr + r->hdrlen;
+        int isid = strncmp(l, "##FILTER=<ID=", 13) == 0 || strncmp(l, "##INFO=<ID=", 11) == 0 || strncmp(l, "##FORMAT=<ID=", 13) == 0;
+        int iscontig = strncmp(l, "##contig=<ID=", 13) == 0;
+        if (isid || iscontig) {
+            char* id = strstr(l, "<ID=") + 4;
+            size_t idlen = strcspn(id, ",>\n");
+            long idx = headerIDX(l, lend);
+            if (isid) {
+                size_t i = 0;
+                for (; i < r->nids; i++) // IDs are shared among FILTER, INFO and FORMAT
+                    if (r->ids[i] && strlen(r->ids[i]) == idlen && strncmp(r->ids[i], id, idlen) == 0)
+                        break;
+                if (i == r->nids) {
+                    i = idx >= 0 ? (size_t) idx : next;
+                    dictSet(&r->ids, &r->nids, i, id, idlen);
+                    if (i >= next)
+                        next = i+1;
+                }
+            } else {
+                size_t i = idx >= 0 ? (size_t) idx : nextcontig;
+                dictSet(&r->contigs, &r->ncontigs, i, id, idlen);
+                if (i >= nextcontig)
+                    nextcontig = i+1;
+            }
+        } else if (strncmp(l, "#CHROM", 6) == 0) {
+            size_t ntabs = 0;
+            for (char* c = l; c < lend; c++)
+                ntabs += *c == '\t';
+            r->nsamples = ntabs > 8 ? ntabs - 8 : 0;
+        }
+        l = lend + 1;
+    }
+}
+
+int bcfDetect(FILE* in) {
+    int c = getc(in);
+    if (c == EOF)
+        return 0;
+    ungetc(c, in);
+    return c == 0x1f || c == 'B';
+}
+
+int bcfOpen(BcfReader* r, FILE* in) {
+    memset(r, 0, sizeof(BcfReader));
+    r->in = in;
+    r->buf = malloc(BCF_BUFSIZE);
+    int c = getc(in);
+    ungetc(c, in);
+    r->compressed = c == 0x1f;
+    if (r->compressed) {
+        r->inbuf = malloc(BCF_INBUFSIZE);
+        if (inflateInit2(&r->zs, 15 + 32) != Z_OK) { // gzip header
+            fprintf(stderr, "ERROR: Failed to initialize zlib.\n");
+            return -1;
+        }
+    }
+
+    char magic[5];
+    if (readBytes(r, magic, 5) != 5 || strncmp(magic, "BCF\2", 4) != 0) {
+        fprintf(stderr, "ERROR: Input is neither uncompressed VCF nor BCF.\n");
+        return -1;
+    }
+    unsigned char l[4];
+    if (readBytes(r, l, 4) != 4) {
+        fprintf(stderr, "ERROR: Truncated BCF header.\n");
+        return -1;
+    }
+    size_t ltext = getLE32(l);
+    r->hdr = malloc(ltext + 2);
+    if (readBytes(r, r->hdr, ltext) != ltext) {
+        fprintf(stderr, "ERROR: Truncated BCF header.\n");
+        return -1;
+    }
+    r->hdr[ltext] = '\0';
+    r->hdrlen = strlen(r->hdr);
+    if (r->hdrlen && r->hdr[r->hdrlen-1] != '\n') { // terminate the last line
+        r->hdr[r->hdrlen++] = '\n';
+        r->hdr[r->hdrlen] = '\0';
+    }
+    parseHeader(r);
+    return 0;
+}
+
+void bcfClose(BcfReader* r) {
+    if (r->compressed)
+        inflateEnd(&r->zs);
+    free(r->inbuf);
+    free(r->buf);
+    free(r->hdr);
+    for (size_t i = 0; i < r->nids; i++)
+        free(r->ids[i]);
+    free(r->ids);
+    for (size_t i = 0; i < r->ncontigs; i++)
+        free(r->contigs[i]);
+    free(r->contigs);
+    free(r->shared);
+    free(r->indiv);
+}
+
+int bcfReadRecord(BcfReader* r) {
+    unsigned char l[8];
+    size_t n = readBytes(r, l, 8);
+    if (n == 0)
+        return -1;
+    if (n != 8) {
+        fprintf(stderr, "ERROR: Truncated BCF record.\n");
+        exit(EXIT_FAILURE);
+    }
+    r->lshared = getLE32(l);
+    r->lindiv = getLE32(l+4);
+    if (r->lshared > r->mshared) {
+        r->mshared = 2 * r->lshared;
+        r->shared = realloc(r->shared, r->mshared);
+    }
+    if (r->lindiv > r->mindiv) {
+        r->mindiv = 2 * r->lindiv;
+        r->indiv = realloc(r->indiv, r->mindiv);
+    }
+    if (r->lshared < 24 || readBytes(r, r->shared, r->lshared) != r->lshared || readBytes(r, r->indiv, r->lindiv) != r->lindiv) {
+        fprintf(stderr, "ERROR: Truncated BCF record.\n");
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+const char* bcfChrom(const BcfReader* r) {
+    uint32_t c = getLE32(r->shared);
+    return c < r->ncontigs && r->contigs[c] ? r->contigs[c] : ".";
+}
+
+// name of a dictionary entry
+static inline const char* idName(const BcfReader* r, int32_t id) {
+    return id >= 0 && (size_t) id < r->nids && r->ids[id] ? r->ids[id] : ".";
+}
+
+void bcfFormatSite(const BcfReader* r, BcfStr* s, int withchrom) {
+    const unsigned char* p = r->shared;
+    if (withchrom) {
+        const char* c = bcfChrom(r);
+        strAppend(s, c, strlen(c));
+        strPut(s, '\t');
+    }
+    strPutInt(s, (int32_t) getLE32(p+4) + 1); // POS
+    strPut(s, '\t');
+    uint32_t qual = getLE32(p+12);
+    uint32_t nallele = getLE32(p+16) >> 16;
+    uint32_t ninfo = getLE32(p+16) & 0xffff;
+    p += 24;
+
+    int type;
+    size_t n;
+    // ID
+    p = typedHeader(p, &type, &n);
+    formatValues(s, p, BCF_BT_CHAR, n);
+    p += n;
+    // REF, ALT
+    for (uint32_t a = 0; a < nallele; a++) {
+        strPut(s, a <= 1 ? '\t' : ',');
+        p = typedHeader(p, &type, &n);
+        strAppend(s, (const char*) p, n);
+        p += n;
+    }
+    if (nallele == 0) // no REF
+        strAppend(s, "\t.", 2);
+    if (nallele <= 1) // no ALT
+        strAppend(s, "\t.", 2);
+    // QUAL
+    strPut(s, '\t');
+    if (qual == BCF_FLOAT_MISSING)
+        strPut(s, '.');
+    else {
+        float f;
+        memcpy(&f, &qual, 4);
+        strPutFloat(s, f);
+    }
+    // FILTER
+    strPut(s, '\t');
+    p = typedHeader(p, &type, &n);
+    if (n == 0)
+        strPut(s, '.');
+    for (size_t i = 0; i < n; i++) {
+        int cls;
+        if (i)
+            strPut(s, ';');
+        const char* f = idName(r, getInt(p, type, &cls));
+        strAppend(s, f, strlen(f));
+        p += typeSize(type);
+    }
+    // INFO
+    strPut(s, '\t');
+    if (ninfo == 0)
+        strPut(s, '.');
+    for (uint32_t i = 0; i < ninfo; i++) {
+        int cls;
+        if (i)
+            strPut(s, ';');
+        p = typedHeader(p, &type, &n); // key
+        const char* k = idName(r, getInt(p, type, &cls));
+        strAppend(s, k, strlen(k));
+        p += typeSize(type);
+        p = typedHeader(p, &type, &n); // values
+        if (type != BCF_BT_NULL) { // not a flag
+            strPut(s, '=');
+            formatValues(s, p, type, n);
+        }
+        p += n * typeSize(type);
+    }
+}
+
+const unsigned char* bcfFormatField(const BcfReader* r, const char* key, int* type, size_t* n) {
+    uint32_t nfmt = getLE32(r->shared + 20) >> 24;
+    size_t nsamples = getLE32(r->shared + 20) & 0xffffff;
+    const unsigned char* p = r->indiv;
+    for (uint32_t f = 0; f < nfmt; f++) {
+        int ktype, cls;
+        size_t kn;
+        p = typedHeader(p, &ktype, &kn);
+        int32_t id = getInt(p, ktype, &cls);
+        p += typeSize(ktype);
+        p = typedHeader(p, type, n);
+        if (strcmp(idName(r, id), key) == 0)
+            return p;
+        p += nsamples * *n * typeSize(*type);
+    }
+    return NULL;
+}
+
+// a FORMAT field of the current record
+typedef struct {
+    const char* key;
+    int isgt;
+    int type;
+    size_t n;                // number of values per sample
+    const unsigned char* p;  // values of the first sample
+} FmtField;
+
+void bcfFormatSamples(const BcfReader* r, BcfStr* s, const char* const* keys, size_t nkeys, const unsigned char* skip, int withformat) {
+    uint32_t nfmt = getLE32(r->shared + 20) >> 24;
+    size_t nsamples = getLE32(r->shared + 20) & 0xffffff;
+    if (nfmt == 0)
+        return;
+
+    // collect all fields
+    FmtField all[nfmt];
+    const unsigned char* p = r->indiv;
+    for (uint32_t f = 0; f < nfmt; f++) {
+        int type, cls;
+        size_t n;
+        p = typedHeader(p, &type, &n);
+        all[f].key = idName(r, getInt(p, type, &cls));
+        all[f].isgt = strcmp(all[f].key, "GT") == 0;
+        p += typeSize(type);
+        p = typedHeader(p, &all[f].type, &all[f].n);
+        all[f].p = p;
+        p += nsamples * all[f].n * typeSize(all[f].type);
+    }
+
+    // select the requested fields in the requested order
+    FmtField sel[nfmt];
+    size_t nsel = 0;
+    if (keys == NULL) {
+        memcpy(sel, all, nfmt * sizeof(FmtField));
+        nsel = nfmt;
+    } else {
+        for (size_t k = 0; k < nkeys; k++)
+            for (uint32_t f = 0; f < nfmt; f++)
+                if (strcmp(all[f].key, keys[k]) == 0) {
+                    sel[nsel++] = all[f];
+                    break;
+                }
+    }
+
+    if (withformat) {
+        strPut(s, '\t');
+        for (size_t f = 0; f < nsel; f++) {
+            if (f)
+                strPut(s, ':');
+            strAppend(s, sel[f].key, strlen(sel[f].key));
+        }
+    }
+
+    for (size_t i = 0; i < nsamples; i++) {
+        strPut(s, '\t');
+        if ((skip && skip[i]) || nsel == 0) {
+            strPut(s, '.');
+            continue;
+        }
+        for (size_t f = 0; f < nsel; f++) {
+            if (f)
+                strPut(s, ':');
+            size_t sz = sel[f].n * typeSize(sel[f].type);
+            const unsigned char* v = sel[f].p + i * sz;
+            if (sel[f].isgt)
+                formatGT(s, v, sel[f].type, sel[f].n);
+            else
+                formatValues(s, v, sel[f].type, sel[f].n);
+        }
+    }
+}
@@ -0,0 +1,129 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BCFREADER_H_
+#define BCFREADER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <zlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// BCF2 types of typed values
+#define BCF_BT_NULL  0
+#define BCF_BT_INT8  1
+#define BCF_BT_INT16 2
+#define BCF_BT_INT32 3
+#define BCF_BT_FLOAT 5
+#define BCF_BT_CHAR  7
+
+/**
+ * Growable string, compatible with a buffer allocated with malloc() (e.g. by getline()).
+ */
+typedef struct {
+    char* s;   /**< data, always null terminated */
+    size_t l;  /**< length (excluding the null terminator) */
+    size_t m;  /**< allocated size */
+} BcfStr;
+
+/** Appends n chars to the string (the buffer is enlarged if required). */
+void bcfStrAppend(BcfStr* s, const char* c, size_t n);
+
+/**
+ * Reader for BCF2 files (BGZF compressed or uncompressed).
+ * Records are read in their binary form and can be formatted as VCF text,
+ * restricted to the required FORMAT fields and samples.
+ */
+typedef struct {
+    FILE* in;
+    int compressed;
+    z_stream zs;
+    unsigned char* inbuf;  // compressed input
+    unsigned char* buf;    // decompressed data
+    size_t bufpos;
+    size_t buflen;
+
+    char* hdr;             /**< VCF header text (null terminated, each line terminated by a newline) */
+    size_t hdrlen;         /**< length of the header text */
+    char** ids;            /**< dictionary of FILTER, INFO and FORMAT IDs (NULL for unused indices) */
+    size_t nids;
+    char** contigs;        /**< dictionary of contigs */
+    size_t ncontigs;
+    size_t nsamples;       /**< number of samples in the #CHROM line */
+
+    // current record
+    unsigned char* shared;
+    size_t lshared;
+    size_t mshared;
+    unsigned char* indiv;
+    size_t lindiv;
+    size_t mindiv;
+} BcfReader;
+
+/**
+ * Returns 1 if the stream starts like a BCF file (gzip magic or "BCF"), without consuming any data.
+ */
+int bcfDetect(FILE* in);
+
+/**
+ * Opens the BCF stream and reads the header. Returns 0 on success. On failure, an error message is printed.
+ */
+int bcfOpen(BcfReader* r, FILE* in);
+
+/** Releases all memory (the stream is not closed). */
+void bcfClose(BcfReader* r);
+
+/** Reads the next record. Returns 0 on success, -1 at the end of the file. */
+int bcfReadRecord(BcfReader* r);
+
+/** Name of the chromosome of the current record. */
+const char* bcfChrom(const BcfReader* r);
+
+/**
+ * Appends the site fields of the current record as VCF text to s, from CHROM (or POS if withchrom is not set)
+ * to INFO (inclusive, without a trailing tab).
+ */
+void bcfFormatSite(const BcfReader* r, BcfStr* s, int withchrom);
+
+/**
+ * Appends the sample columns of the current record as VCF text to s, each preceded by a tab.
+ * @param keys FORMAT fields to be formatted in this order (if present in the record), or NULL for all fields
+ * @param nkeys number of keys
+ * @param skip if not NULL, samples with a non-zero entry are printed as '.' only (they are not decoded)
+ * @param withformat if set, the FORMAT column is printed first
+ */
+void bcfFormatSamples(const BcfReader* r, BcfStr* s, const char* const* keys, size_t nkeys, const unsigned char* skip, int withformat);
+
+/**
+ * Returns the typed values of a FORMAT field of the current record (n values of the given BCF type for each sample,
+ * stored consecutively in the order of the samples, little endian), or NULL if the record does not contain the field.
+ */
+const unsigned char* bcfFormatField(const BcfReader* r, const char* key, int* type, size_t* n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BCFREADER_H_ */
@@ -0,0 +1,200 @@
+/*
+ *    Copyright (C) 2025 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "MergeArgs.h"
+
+namespace bpo = boost::program_options;
+
+using namespace std;
+using namespace bpo;
+
+/**
+ * @brief Constructs, parses and verifies all command-line arguments
+ *
+ * This function constructs the Args object and parses all given command-line
+ * arguments. If unknown arguments and/or missing obligatory arguments are
+ * detected, this function does not return and instead prints an appropriate
+ * help message and calls exit(), executing all exit handlers registered
+ * up to the parseArgs call.
+ *
+ * @param argc argument count
+ * @param argv argument vector
+ * @return an rvalue reference of a new Args object containing all defined or defaulted CLI arguments
+ */
+/*static*/ MergeArgs MergeArgs::parseArgs(int argc, char *argv[]) {
+    MergeArgs args {argc, argv};
+
+    if (args.count("help")) {
+        args.printHelp(argv[0], cerr);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (args.count("version")) {
+        args.printVersion(cerr);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (args.inputs.size() < 2) {
+        cerr << "You need to specify at least two extraction files to be merged." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // set variables
+    args.parseVars();
+
+    if (args.fill != "missing" && args.fill != "ref") {
+        cerr << "ERROR: Unknown fill genotype \"" << args.fill << "\". Expecting missing or ref." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return args;
+}
+
+ostream &operator<<(ostream &out, const MergeArgs &args) {
+    variables_map::const_iterator it;
+
+    long name_width = 0;
+    long value_width = 0;
+    long orig_width = out.width();
+
+    // collect field widths
+    for(it = args.vars.begin(); it != args.vars.end(); ++it) {
+        long this_width = static_cast<long>(it->first.length());
+
+        if(this_width > name_width) {
+            name_width = this_width;
+        }
+
+        this_width = 0;
+
+        if(it->second.value().type() == typeid(string)) {
+            this_width = static_cast<long>(it->second.as<string>().length());
+        }
+
+        if(it->second.value().type() == typeid(int)) {
+            this_width = static_cast<long>(log10(it->second.as<int>()));
+        }
+
+        if(this_width > value_width) {
+            value_width = this_width;
+        }
+    }
+
+    // dump option values
+    out.setf(ios::adjustfield, ios::left);
+
+    for(it = args.vars.begin(); it != args.vars.end(); ++it) {
+        out.width(name_width + 2); // more space for the colon
+        out << (it->first + ":") << endl;
+
+        out.width(value_width);
+
+        if(it->second.value().type() == typeid(string)) {
+            out << it->second.as<string>() << endl;
+        } else if(it->second.value().type() == typeid(int)) {
+            out << it->second.as<int>() << endl;
+        } else {
+            out << "(unknown)" << endl;
+        }
+    }
+
+    resetiosflags(ios::adjustfield);
+    out.width(orig_width);
+
+    return out;
+}
+
+MergeArgs::MergeArgs(int argc, char *argv[]) :
+    opts_regular("Program options"),
+    opts_hidden("Hidden options (only visible in debug mode)")
+    {
+
+    opts_regular.add_options()
+    ("help,h", "produces this help message and exits")
+    ("version,v", "prints version information and exits")
+    ("fill", value<string>(&fill)->default_value("missing"), "genotype for the samples of a file that does not contain a variant: missing (./.) or ref (0/0). The ploidy of each sample is taken from the first variant of its file.")
+    ;
+
+    opts_hidden.add_options()
+    ("input", value<vector<string>>(&inputs)->composing(), "extraction files to be merged (positional args)")
+    ("debug", "produce lots of debug output")
+    ;
+
+    opts_positional.add("input", -1);
+
+    parse(argc, argv);
+}
+
+void MergeArgs::parse(int argc, char *argv[]) {
+    bpo::options_description all_options;
+
+    // combine all options
+    all_options.add(opts_regular);
+    all_options.add(opts_hidden);
+
+    // do the actual parsing
+    store(command_line_parser(argc, argv).options(all_options).positional(opts_positional).run(), vars);
+    notify(vars);
+
+}
+
+void MergeArgs::parseVars() {
+
+    if (vars.count("debug"))
+        debug = true;
+    if (fill == "ref")
+        fillref = true;
+
+}
+
+bool MergeArgs::isDefined(const string &optname) const {
+    bool found = false;
+    found = !!this->opts_regular.find_nothrow(optname, false); // return null (-> false) if option has not been found
+    found |= !!this->opts_hidden.find_nothrow(optname, false);
+    return found;
+}
+
+void MergeArgs::printHelp(const string &progname, ostream &out) const {
+    out << "Usage: " << progname << " [options] <extraction1> <extraction2> [...]" << endl << endl;
+    out << opts_regular << endl;
+    if (debug) {
+        out << opts_hidden << endl;
+    }
+    out << endl;
+
+    out << " The tool merges extractions of vcffilter of the same chromosome with different sets of samples into a new extraction, which is printed to stdout.\n";
+    out << " The input files (plain or gzip compressed) need to be sorted by position. Variants are joined by POS, REF and ALT, multi-allelic variants\n";
+    out << " need to have identical ALT columns. ID, QUAL, FILTER and INFO are taken from the first file containing the variant, AC, AN and AF are recalculated.\n";
+    out << " The samples are concatenated in the order of the input files. GQ is kept only if all extractions contain it." << endl;
+    out << " Information will be printed to stderr." << endl;
+
+    printVersion(out);
+}
+
+/* static */
+void MergeArgs::printVersion(ostream &out) {
+    out << "This is version 0.1." << endl;
+}
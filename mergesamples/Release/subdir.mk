@@ -0,0 +1,44 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../../restorevcf/LineReader.cpp \
+../MergeArgs.cpp \
+../mergesamples.cpp 
+
+CPP_DEPS += \
+./LineReader.d \
+./MergeArgs.d \
+./mergesamples.d 
+
+OBJS += \
+./LineReader.o \
+./MergeArgs.o \
+./mergesamples.o 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+%.o: ../%.cpp subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -O3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+LineReader.o: ../../restorevcf/LineReader.cpp subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -O3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
+clean: clean--2e-
+
+clean--2e-:
+	-$(RM) ./LineReader.d ./LineReader.o ./MergeArgs.d ./MergeArgs.o ./mergesamples.d ./mergesamples.o
+
+.PHONY: clean--2e-
+
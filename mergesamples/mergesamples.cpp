@@ -0,0 +1,492 @@
+/*
+ *    Copyright (C) 2025 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <charconv>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "MergeArgs.h"
+#include "../restorevcf/LineReader.h"
+
+// output is written when the buffer exceeds this size
+#define OUTBUFSIZE 1048576
+
+using namespace std;
+
+// an input extraction
+struct MergeInput {
+    string filename;
+    LineReader* reader = NULL;
+    bool gq = false;         // contains GQ fields
+    vector<string> hdr;      // embedded VCF header (without the #CHROM line)
+    vector<string> samples;  // sample IDs from the embedded #CHROM line
+    size_t nsamples = 0;
+    vector<unsigned char> ploidy; // ploidy of each sample in the first data line
+    string fill;             // genotypes of all samples for a missing variant (tab separated)
+    size_t fillan = 0;       // allele number of the fill genotypes
+    char* line = NULL;       // current data line
+    size_t len = 0;
+    ssize_t nline = -1;      // length of the current data line, -1 at the end of the file
+    long pos = 0;            // position of the current data line
+    vector<string> group;    // all lines at the current merge position
+};
+
+// a line of an extraction split into its columns
+struct Record {
+    const char* pos;      // POS up to INFO (tab separated)
+    const char* ref;      // REF and ALT (tab separated)
+    const char* refaltend;
+    const char* info;
+    const char* infoend;
+    const char* gt;       // genotypes
+    const char* gtend;
+    bool used = false;
+};
+
+static void splitRecord(const string& l, Record& r) {
+    const char* p = l.data();
+    const char* end = p + l.size();
+    while (end > p && (end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+    const char* cols[8];
+    cols[0] = p;
+    for (int c = 1; c < 8; c++) {
+        const char* tab = (const char*) memchr(p, '\t', end - p);
+        p = tab ? tab + 1 : end;
+        cols[c] = p;
+    }
+    r.pos = cols[0];
+    r.ref = cols[2];
+    r.refaltend = cols[4] - 1;
+    r.info = cols[6];
+    r.infoend = cols[7] > cols[6] ? cols[7] - 1 : cols[7];
+    r.gt = cols[7];
+    r.gtend = end;
+}
+
+// reads the next data line of the input and parses its position
+static void nextLine(MergeInput& in) {
+    long prev = in.pos;
+    in.nline = in.reader->getline(&in.line, &in.len);
+    // skip empty lines or embedded headers of concatenated files
+    while (in.nline != -1 && (*in.line == '#' || strchr(in.line, '\t') == NULL))
+        in.nline = in.reader->getline(&in.line, &in.len);
+    if (in.nline == -1)
+        return;
+    in.pos = atol(in.line);
+    if (in.pos < prev) {
+        cerr << "ERROR: " << in.filename << " is not sorted by position (" << in.pos << " after " << prev << ")." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// reads the header of an extraction: the chromosome name followed by the args of vcffilter,
+// and the embedded VCF header (if present), up to the first data line
+static bool readExtractionHeader(MergeInput& in, string& chrom) {
+    ssize_t nh = in.reader->getline(&in.line, &in.len);
+    if (nh <= 0)
+        return false;
+    while (nh && (in.line[nh-1] == '\n' || in.line[nh-1] == '\r'))
+        in.line[--nh] = '\0';
+    char* chrend = strpbrk(in.line, ";\t");
+    chrom = string(in.line, chrend ? chrend - in.line : nh);
+    for (char* arg = chrend ? chrend + 1 : NULL; arg != NULL; ) {
+        char* argend = strchr(arg, ';');
+        if (argend != NULL)
+            *argend = '\0';
+        if (strcmp(arg, "--gq") == 0)
+            in.gq = true;
+        arg = argend ? argend + 1 : NULL;
+    }
+    for (in.nline = in.reader->getline(&in.line, &in.len); in.nline != -1 && *in.line == '#'; in.nline = in.reader->getline(&in.line, &in.len)) {
+        size_t n = in.nline;
+        while (n && (in.line[n-1] == '\n' || in.line[n-1] == '\r'))
+            n--;
+        if (strncmp(in.line, "#CHROM", 6) == 0) {
+            // sample IDs follow POS ... FORMAT
+            const char* p = in.line;
+            const char* end = in.line + n;
+            for (int c = 0; c < 9 && p; c++) {
+                p = (const char*) memchr(p, '\t', end - p);
+                if (p)
+                    p++;
+            }
+            while (p && p < end) {
+                const char* tab = (const char*) memchr(p, '\t', end - p);
+                const char* send = tab ? tab : end;
+                in.samples.push_back(string(p, send));
+                p = tab ? tab + 1 : NULL;
+            }
+        } else
+            in.hdr.push_back(string(in.line, n));
+    }
+    if (in.nline != -1)
+        in.pos = atol(in.line);
+    return true;
+}
+
+// appends the genotypes (without GQ if strip is set) and counts the alleles, returns the number of samples
+static size_t appendGenotypes(string& out, const char* gt, const char* gtend, bool strip, vector<size_t>& ac, size_t& an) {
+    if (!strip)
+        out.append(gt, gtend);
+    size_t ns = gt < gtend ? 1 : 0;
+    bool ingt = true;
+    for (const char* p = gt; p < gtend; p++) {
+        char c = *p;
+        if (c == '\t') {
+            ns++;
+            ingt = true;
+        } else if (!ingt)
+            continue;
+        else if (c == ':') {
+            ingt = false;
+            continue;
+        } else if (c >= '0' && c <= '9') {
+            size_t idx = 0;
+            const char* d = p;
+            for (; p < gtend && *p >= '0' && *p <= '9'; p++)
+                idx = idx * 10 + (*p - '0');
+            if (strip)
+                out.append(d, p);
+            if (idx >= ac.size())
+                ac.resize(idx + 1, 0);
+            ac[idx]++;
+            an++;
+            p--;
+            continue;
+        }
+        if (strip)
+            out.push_back(c);
+    }
+    return ns;
+}
+
+// appends an unsigned integer
+static inline void appendUInt(string& out, size_t v) {
+    char buf[24];
+    char* end = to_chars(buf, buf+sizeof(buf), v).ptr;
+    out.append(buf, end);
+}
+
+// appends a float with 8 decimal places (same as printf's "%.8f")
+static inline void appendFloat8(string& out, float v) {
+    char buf[64];
+    char* end = to_chars(buf, buf+sizeof(buf), v, chars_format::fixed, 8).ptr;
+    out.append(buf, end);
+}
+
+// appends the INFO column with AC, AN and AF replaced by the recalculated values
+// (AC and AN are added if not present)
+static void appendInfo(string& out, const char* info, const char* infoend, const vector<size_t>& ac, size_t an, size_t nalt) {
+    auto appendAC = [&]() {
+        out.append("AC=");
+        for (size_t a = 1; a <= nalt; a++) {
+            if (a > 1)
+                out.push_back(',');
+            appendUInt(out, a < ac.size() ? ac[a] : 0);
+        }
+    };
+    auto appendAF = [&]() {
+        out.append("AF=");
+        for (size_t a = 1; a <= nalt; a++) {
+            if (a > 1)
+                out.push_back(',');
+            if (an)
+                appendFloat8(out, (a < ac.size() ? ac[a] : 0) / (float) an);
+            else
+                out.push_back('.');
+        }
+    };
+    bool hasac = false, hasan = false;
+    bool first = true;
+    if (!(infoend - info == 1 && *info == '.')) {
+        for (const char* f = info; f < infoend; ) {
+            const char* fend = (const char*) memchr(f, ';', infoend - f);
+            if (!fend)
+                fend = infoend;
+            if (!first)
+                out.push_back(';');
+            first = false;
+            if (fend - f >= 3 && f[0] == 'A' && (f[1] == 'C' || f[1] == 'N' || f[1] == 'F') && f[2] == '=') {
+                if (f[1] == 'C') {
+                    appendAC();
+                    hasac = true;
+                } else if (f[1] == 'N') {
+                    out.append("AN=");
+                    appendUInt(out, an);
+                    hasan = true;
+                } else
+                    appendAF();
+            } else
+                out.append(f, fend);
+            f = fend + 1;
+        }
+    }
+    if (!hasac && nalt) {
+        if (!first)
+            out.push_back(';');
+        first = false;
+        appendAC();
+    }
+    if (!hasan) {
+        if (!first)
+            out.push_back(';');
+        out.append("AN=");
+        appendUInt(out, an);
+    }
+}
+
+int main (int argc, char **argv) {
+
+    // parse args
+    MergeArgs args = MergeArgs::parseArgs(argc, argv);
+
+    const vector<string>& inputs = args.inputs;
+    bool fillref = args.fillref;
+
+    cerr << "Args:" << endl;
+    cerr << "  inputs:       ";
+    for (const string& f : inputs)
+        cerr << " " << f;
+    cerr << endl;
+    cerr << "  fill:          " << args.fill << endl;
+    cerr << endl;
+
+    // read the headers
+    vector<MergeInput> ins(inputs.size());
+    string chrom;
+    bool gq = true; // GQ is kept only if all inputs contain it
+    bool withheader = true; // the VCF header (the sample IDs) is only written if all inputs contain it
+    for (size_t i = 0; i < inputs.size(); i++) {
+        MergeInput& in = ins[i];
+        in.filename = inputs[i];
+        in.reader = new LineReader(in.filename);
+        string c;
+        if (!readExtractionHeader(in, c)) {
+            cerr << "ERROR: " << in.filename << " is empty." << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (i == 0)
+            chrom = c;
+        else if (c != chrom) {
+            cerr << "ERROR: Input files contain different chromosomes: " << chrom << " (" << inputs[0] << ") and " << c << " (" << in.filename << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+        gq &= in.gq;
+        withheader &= !in.samples.empty(); // the #CHROM line is not stored in hdr
+
+        // number of samples from the header, or from the first line (POS ... INFO are followed by the genotypes)
+        in.nsamples = in.samples.size();
+        vector<unsigned char>& ploidy = in.ploidy;
+        if (in.nline != -1) {
+            Record r;
+            string l(in.line, in.nline);
+            splitRecord(l, r);
+            for (const char* p = r.gt; p < r.gtend; ) {
+                unsigned char pl = 1;
+                for (; p < r.gtend && *p != '\t' && *p != ':'; p++)
+                    if (*p == '/' || *p == '|')
+                        pl++;
+                ploidy.push_back(pl);
+                while (p < r.gtend && *p != '\t')
+                    p++;
+                if (p < r.gtend)
+                    p++;
+            }
+            if (in.samples.empty())
+                in.nsamples = ploidy.size();
+            else if (ploidy.size() != in.nsamples) {
+                cerr << "ERROR: Number of samples in the first line of " << in.filename << " (" << ploidy.size() << ") does not match the header (" << in.nsamples << ")." << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        ploidy.resize(in.nsamples, 2); // no variants: assume diploid samples
+        cerr << in.filename << ": " << in.nsamples << " samples" << (in.gq ? " (with GQ)" : "") << endl;
+    }
+
+    // fill genotypes for variants missing in a file, with the ploidy of the first variant
+    for (MergeInput& in : ins) {
+        const vector<unsigned char>& ploidy = in.ploidy;
+        for (size_t s = 0; s < in.nsamples; s++) {
+            if (s)
+                in.fill.push_back('\t');
+            for (unsigned char a = 0; a < ploidy[s]; a++) {
+                if (a)
+                    in.fill.push_back('/');
+                in.fill.push_back(fillref ? '0' : '.');
+            }
+            if (gq)
+                in.fill.append(":.");
+            if (fillref)
+                in.fillan += ploidy[s];
+        }
+    }
+    if (!gq) {
+        for (const MergeInput& in : ins)
+            if (in.gq)
+                cerr << "WARNING: GQ fields of " << in.filename << " are removed as not all extractions contain them." << endl;
+    }
+
+    // print the header
+    string out;
+    out.append(chrom);
+    if (gq)
+        out.append(";--gq");
+    out.push_back('\n');
+    if (withheader) {
+        // the header lines are taken from the first input that contains them
+        const MergeInput* hdrin = &ins[0];
+        for (const MergeInput& in : ins) {
+            if (!in.hdr.empty()) {
+                hdrin = &in;
+                break;
+            }
+        }
+        for (const string& h : hdrin->hdr) {
+            // the description of GQ is dropped if GQ is removed (as by vcffilter without --gq)
+            if (!gq && h.compare(0, 15, "##FORMAT=<ID=GQ") == 0 && (h[15] == ',' || h[15] == '>'))
+                continue;
+            out.append(h);
+            out.push_back('\n');
+        }
+        out.append("##mergesamples_command=");
+        for (int i = 0; i < argc; i++) {
+            if (i)
+                out.push_back(' ');
+            out.append(argv[i]);
+        }
+        out.append("\n#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
+        unordered_set<string> ids;
+        for (const MergeInput& in : ins) {
+            for (const string& s : in.samples) {
+                if (!ids.insert(s).second) {
+                    cerr << "ERROR: Sample " << s << " is contained in more than one extraction." << endl;
+                    exit(EXIT_FAILURE);
+                }
+                out.push_back('\t');
+                out.append(s);
+            }
+        }
+        out.push_back('\n');
+    } else
+        cerr << "WARNING: Not all extractions contain the VCF header, the merged extraction will be without header." << endl;
+
+    // merge: all lines at the smallest position are collected from each file and joined by REF and ALT
+    size_t nvars = 0;
+    size_t nmissing = 0; // number of filled genotype blocks
+    vector<size_t> ac;
+    string gts;
+    vector<vector<Record>> recs(ins.size());
+    for (;;) {
+        long pos = -1;
+        for (const MergeInput& in : ins)
+            if (in.nline != -1 && (pos < 0 || in.pos < pos))
+                pos = in.pos;
+        if (pos < 0)
+            break;
+        for (size_t i = 0; i < ins.size(); i++) {
+            MergeInput& in = ins[i];
+            in.group.clear();
+            while (in.nline != -1 && in.pos == pos) {
+                in.group.push_back(string(in.line, in.nline));
+                nextLine(in);
+            }
+            recs[i].resize(in.group.size());
+            for (size_t j = 0; j < in.group.size(); j++) {
+                splitRecord(in.group[j], recs[i][j]);
+                recs[i][j].used = false;
+            }
+        }
+
+        // variants in the order of their first appearance
+        for (size_t i = 0; i < ins.size(); i++) {
+            for (Record& r : recs[i]) {
+                if (r.used)
+                    continue;
+                size_t keylen = r.refaltend - r.ref;
+                ac.assign(1, 0);
+                size_t an = 0;
+                gts.clear();
+                for (size_t k = 0; k < ins.size(); k++) {
+                    if (k)
+                        gts.push_back('\t');
+                    // the first unused record with the same REF and ALT
+                    Record* match = NULL;
+                    for (Record& o : recs[k]) {
+                        if (!o.used && (size_t) (o.refaltend - o.ref) == keylen && memcmp(o.ref, r.ref, keylen) == 0) {
+                            match = &o;
+                            break;
+                        }
+                    }
+                    if (match) {
+                        match->used = true;
+                        size_t ns = appendGenotypes(gts, match->gt, match->gtend, ins[k].gq && !gq, ac, an);
+                        if (ns != ins[k].nsamples) {
+                            cerr << "ERROR: Number of samples at position " << pos << " in " << ins[k].filename << " (" << ns << ") does not match (" << ins[k].nsamples << ")." << endl;
+                            exit(EXIT_FAILURE);
+                        }
+                    } else {
+                        gts.append(ins[k].fill);
+                        an += ins[k].fillan;
+                        if (fillref)
+                            ac[0] += ins[k].fillan;
+                        nmissing++;
+                    }
+                }
+                const char* alt = (const char*) memchr(r.ref, '\t', keylen);
+                size_t nalt = 0;
+                if (alt && !(r.refaltend - alt == 2 && alt[1] == '.'))
+                    nalt = count(alt, r.refaltend, ',') + 1;
+                if (ac.size() > nalt + 1) {
+                    cerr << "ERROR: Allele index exceeds the number of alleles at position " << pos << "." << endl;
+                    exit(EXIT_FAILURE);
+                }
+
+                out.append(r.pos, r.info); // POS ... FILTER
+                appendInfo(out, r.info, r.infoend, ac, an, nalt);
+                out.push_back('\t');
+                out.append(gts);
+                out.push_back('\n');
+                nvars++;
+                if (out.size() >= OUTBUFSIZE) {
+                    fwrite(out.data(), 1, out.size(), stdout);
+                    out.clear();
+                }
+            }
+        }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+
+    size_t ntotal = 0;
+    for (MergeInput& in : ins) {
+        ntotal += in.nsamples;
+        delete in.reader;
+        free(in.line);
+    }
+    cerr << "Merged samples: " << ntotal << endl;
+    cerr << "Merged variants: " << nvars << endl;
+    cerr << "Filled genotype blocks of missing variants: " << nmissing << endl;
+}
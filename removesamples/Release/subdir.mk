@@ -3,16 +3,26 @@
 ################################################################################
 
 # Add inputs and outputs from these tool invocations to the build variables 
+C_SRCS += \
+../../bcfreader.c 
+
 CPP_SRCS += \
+../../restorevcf/VarStats.cpp \
 ../RemoveArgs.cpp \
 ../removesamples.cpp 
 
+C_DEPS += \
+./bcfreader.d 
+
 CPP_DEPS += \
 ./RemoveArgs.d \
+./VarStats.d \
 ./removesamples.d 
 
 OBJS += \
 ./RemoveArgs.o \
+./VarStats.o \
+./bcfreader.o \
 ./removesamples.o 
 
 
@@ -24,11 +34,25 @@ OBJS += \
 	@echo 'Finished building: $<'
 	@echo ' '
 
+bcfreader.o: ../../bcfreader.c subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C Compiler'
+	gcc -O3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+VarStats.o: ../../restorevcf/VarStats.cpp subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -O3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
 
 clean: clean--2e-
 
 clean--2e-:
-	-$(RM) ./RemoveArgs.d ./RemoveArgs.o ./removesamples.d ./removesamples.o
+	-$(RM) ./RemoveArgs.d ./RemoveArgs.o ./VarStats.d ./VarStats.o ./bcfreader.d ./bcfreader.o ./removesamples.d ./removesamples.o
 
 .PHONY: clean--2e-
 
@@ -71,6 +71,12 @@ using namespace bpo;
         exit(EXIT_FAILURE);
     }
 
+    // reordering is only possible for a list of samples to keep
+    if (args.reorder && !args.keep) {
+        cerr << "ERROR: --reorder requires --keep." << endl;
+        exit(EXIT_FAILURE);
+    }
+
     return args;
 }
 
@@ -139,6 +145,12 @@ RemoveArgs::RemoveArgs(int argc, char *argv[]) :
     ("macfilter", value<size_t>(&macfilter)->default_value(0), "only variants with a minor allele count >= value are returned")
     ("maffilter", value<float>(&maffilter)->default_value(0.0), "only variants with a minor allele frequency >= value are returned")
     ("missfilter", value<float>(&missfilter)->default_value(0.0), "only variants with a genotype missingness rate < value are returned")
+    ("keep", "the sample ID file contains the samples to keep instead of the samples to remove")
+    ("reorder", "write the kept samples in the order of the sample ID file (requires --keep)")
+    ("sampleqc", value<string>(&sampleqcfilename), "write per-sample QC statistics (missing, heterozygous, homozygous alt and singleton genotypes) of the output variants to the given TSV file")
+    ("stats", "write allele counts for each alt allele and add the fraction of missing genotypes (F_MISSING) and the Hardy-Weinberg exact test p-value (HWE) to the INFO field")
+    ("hwefilter", value<float>(&hwefilter)->default_value(0.0), "only variants with a Hardy-Weinberg exact test p-value >= value for all alt alleles are returned")
+    ("groups", value<string>(&groupsfilename), "file with sample groups (SAMPLE GROUP per line), allele counts and numbers are added to the INFO field for each group (AC_GROUP, AN_GROUP)")
     ;
 
     opts_hidden.add_options()
@@ -169,6 +181,15 @@ void RemoveArgs::parseVars() {
     if (vars.count("debug"))
         debug = true;
 
+    if (vars.count("keep"))
+        keep = true;
+
+    if (vars.count("reorder"))
+        reorder = true;
+
+    if (vars.count("stats"))
+        stats = true;
+
 }
 
 bool RemoveArgs::isDefined(const string &optname) const {
@@ -190,6 +211,7 @@ void RemoveArgs::printHelp(const string &progname, ostream &out) const {
     out << " The tool also skips all information in the INFO column, but recalculates and sets allele count (AC) and allele number (AN) appropriately.\n";
     out << " Further, genotypes (GT) are expected to be the first entry in each sample column. Here, all information is kept." << endl;
     out << " Multi-allelics are not supported. All alleles differing from '0' are counted for AC." << endl;
+    out << " With --keep, only the samples in the provided file are kept, with --reorder additionally in the order of the file." << endl;
     out << " Information will be printed to stderr." << endl;
 
     printVersion(out);
@@ -85,6 +85,12 @@ public:
     float maffilter = 0;
     float missfilter = 0;
     string skipidfilename;
+    bool keep = false;
+    bool reorder = false;
+    string sampleqcfilename;
+    bool stats = false;
+    float hwefilter = 0;
+    string groupsfilename;
 
     bool debug = false;
 
@@ -22,18 +22,264 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "RemoveArgs.h"
+#include "../bcfreader.h"
+#include "../restorevcf/VarStats.h"
 
 // large buffer
 #define BUFSIZE 1073741824
 
+// output is written when the buffer exceeds this size
+#define OUTBUFSIZE 1048576
+
 using namespace std;
 
+#ifdef __SSE2__
+// Counts the alleles of four diploid sample columns with single char alleles at once ("\ta|b\ta|b\ta|b\ta|b").
+// s points to the tab in front of the first column, the 17th char has to be readable as well (end of the fourth column).
+// Returns false without counting anything, if the columns do not match this layout.
+// nonref is set to the positions of all alleles that are not '0' (i.e. alt or missing).
+static inline bool countAlleles4(const char* s, size_t& ac, size_t& an, size_t& missc, unsigned& nonref) {
+    __m128i v = _mm_loadu_si128((const __m128i*) s);
+    unsigned tabs = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    unsigned seps = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('|')), _mm_cmpeq_epi8(v, _mm_set1_epi8('/'))));
+    if (tabs != 0x1111 || (seps & 0x4444) != 0x4444 || (s[16] != '\t' && s[16] != '\n'))
+        return false;
+    // alleles are at the odd positions, first alleles at positions 1, 5, 9 and 13
+    unsigned miss = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('.'))) & 0xaaaa;
+    unsigned ref = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('0'))) & 0xaaaa;
+    ac += __builtin_popcount(0xaaaa & ~miss & ~ref);
+    missc += __builtin_popcount(miss);
+    an += __builtin_popcount(0xaaaa & ~miss); // only called alleles
+    nonref = 0xaaaa & ~ref;
+    return true;
+}
+#endif
+
+/**
+ * A run of consecutive kept samples in the input. Each line is written as
+ * the gathered runs in the order of their output position.
+ */
+struct SampleRun {
+    size_t first; /**< index of the first sample in the input */
+    size_t n;     /**< number of samples */
+    size_t out;   /**< position of the run in the output */
+    size_t outidx; /**< position of the first sample of the run in the output */
+};
+
+/**
+ * Per-sample QC counters of the output variants, stored as structure of arrays
+ * indexed by the position of the sample in the output.
+ * The genotypes of a line are collected as events first (homozygous reference genotypes
+ * are not recorded), the counters are only updated if the line passes the filters.
+ */
+struct SampleQC {
+    vector<uint32_t> nhet;       /**< heterozygous genotypes */
+    vector<uint32_t> nhomalt;    /**< homozygous (or haploid) alternative genotypes */
+    vector<uint32_t> nmiss;      /**< genotypes with at least one missing allele */
+    vector<uint32_t> nsingleton; /**< variants where the sample carries the only alternative allele */
+
+    // events of the current line
+    vector<uint32_t> linehet;
+    vector<uint32_t> linehomalt;
+    vector<uint32_t> linemiss;
+    uint32_t linealt = 0;        /**< the last sample carrying an alternative allele */
+
+    void init(size_t nsamples) {
+        nhet.assign(nsamples, 0);
+        nhomalt.assign(nsamples, 0);
+        nmiss.assign(nsamples, 0);
+        nsingleton.assign(nsamples, 0);
+    }
+
+    void clearLine() {
+        linehet.clear();
+        linehomalt.clear();
+        linemiss.clear();
+    }
+
+    static const int MISSING = -1; /**< missing allele */
+    static const int NONE = -2;    /**< no second allele (haploid genotype) */
+
+    // records the genotype of a sample given by its allele indices, a1 is NONE for haploid genotypes
+    inline void add(uint32_t idx, int a0, int a1) {
+        if (a0 > 0 || a1 > 0)
+            linealt = idx;
+        if (a0 == MISSING || a1 == MISSING)
+            linemiss.push_back(idx);
+        else if (a1 != NONE && a0 != a1)
+            linehet.push_back(idx);
+        else if (a0 != 0)
+            linehomalt.push_back(idx);
+    }
+
+    // applies the events of a line that passed the filters, ac is the allele count of the line
+    void applyLine(size_t ac) {
+        for (uint32_t idx : linehet)
+            nhet[idx]++;
+        for (uint32_t idx : linehomalt)
+            nhomalt[idx]++;
+        for (uint32_t idx : linemiss)
+            nmiss[idx]++;
+        if (ac == 1)
+            nsingleton[linealt]++;
+    }
+};
+
+// Parses the allele index at a (which may have several digits), returns SampleQC::MISSING for a missing allele ('.').
+static inline int parseAllele(const char* a) {
+    if (*a == '.')
+        return SampleQC::MISSING;
+    int v = 0;
+    for (; *a >= '0' && *a <= '9'; a++)
+        v = v * 10 + (*a - '0');
+    return v;
+}
+
+// Counts the alleles of n sample columns and returns the end of the last column (the tab in front of the next column or gtend).
+// s points to the tab in front of the first column, gtend to the end of the genotypes (the newline character),
+// readend to the end of the readable line. gtonly is set if the FORMAT column is GT only, i.e. the sample columns
+// do not contain further fields, only then the columns are tried to be counted four at a time.
+// If QC is set, the genotypes are recorded in qc as well, outidx is the output position of the first sample.
+template<bool QC>
+static char* countRun(char* s, size_t n, const char* gtend, const char* readend, bool gtonly, size_t& ac, size_t& an, size_t& missc, SampleQC* qc, size_t outidx) {
+    for (size_t i = 0; i < n && s < gtend; i++) {
+
+#ifdef __SSE2__
+        // four diploid samples at once, if at least four samples are left in this run
+        unsigned nonref;
+        if (gtonly && n - i >= 4 && s + 17 <= readend && countAlleles4(s, ac, an, missc, nonref)) {
+            if (QC) { // only samples with a non-reference allele are recorded
+                for (unsigned k = 0; k < 4; k++)
+                    if (nonref & (0xa << (4*k)))
+                        qc->add(outidx + i + k, parseAllele(s+4*k+1), parseAllele(s+4*k+3));
+            }
+            s += 16; // tab before the fifth sample column
+            i += 3;
+            continue;
+        }
+#endif
+
+        s++; // first character of sample column
+
+        // we assume the first character represents the first allele, all alleles different from 0 or missing (.) are counted
+        if (*s != '.') {
+            if (*s != '0')
+                ac++;
+            an++;
+        } else
+            missc++;
+
+        // find end of current sample column and the separator of a diploid genotype in a single pass
+        char* sce = s + 1;
+        char* sc2 = NULL;
+        for (; sce < gtend && *sce != '\t'; sce++) {
+            if (!sc2 && (*sce == '|' || *sce == '/'))
+                sc2 = sce;
+        }
+
+        // diploid (phased or unphased)? -> count second allele
+        if (sc2) {
+            sc2++; // points to allele
+            if (*sc2 != '.') {
+                if (*sc2 != '0')
+                    ac++;
+                an++;
+            } else
+                missc++;
+        }
+
+        if (QC)
+            qc->add(outidx + i, parseAllele(s), sc2 ? parseAllele(sc2) : SampleQC::NONE);
+
+        s = sce;
+    }
+    return s;
+}
+
+// Returns the end of the n-th sample column (the tab in front of the next column or gtend),
+// s points to the tab in front of the first column, gtend to the end of the genotypes.
+static inline char* skipColumns(char* s, size_t n, const char* gtend) {
+    for (size_t i = 0; i < n && s < gtend; i++) {
+        s = (char*) memchr(s+1, '\t', gtend-s-1);
+        if (!s)
+            return (char*) gtend;
+    }
+    return s;
+}
+
+// Counts the alleles of the kept samples (skip[i] == 0) directly from the typed GT values of a BCF record
+// with n values per sample, with the same semantics as countRun on the formatted genotypes.
+template<typename T>
+static void countBcfGT(const unsigned char* p, size_t n, size_t nsamples, const unsigned char* skip, size_t& ac, size_t& an, size_t& missc) {
+    const T vmiss = numeric_limits<T>::min();
+    const T vend = vmiss + 1;
+    for (size_t i = 0; i < nsamples; i++, p += n * sizeof(T)) {
+        if (skip[i])
+            continue;
+        T v[2] = {vend, vend};
+        memcpy(v, p, min(n, (size_t) 2) * sizeof(T));
+        if (v[0] == vend) { // empty genotype (formatted as '.')
+            missc++;
+            continue;
+        }
+        // values are (allele+1)<<1 | phased, 0 is a missing allele
+        if (v[0] == vmiss || (v[0] >> 1) == 0)
+            missc++;
+        else {
+            if ((v[0] >> 1) != 1)
+                ac++;
+            an++;
+        }
+        if (v[1] != vend) { // diploid
+            if (v[1] == vmiss || (v[1] >> 1) == 0)
+                missc++;
+            else {
+                if ((v[1] >> 1) != 1)
+                    ac++;
+                an++;
+            }
+        }
+    }
+}
+
+// Appends a floating point value in general format with 6 significant digits (as printf's %g).
+static inline void appendFloatG(string& out, double v) {
+    char num[32];
+    out.append(num, to_chars(num, num+sizeof(num), v, chars_format::general, 6).ptr);
+}
+
+// Returns true if the INFO description in the header line l describes a field that is added by this tool.
+static bool isAddedInfo(const char* l, bool stats, const vector<string>& groupnames) {
+    if (strncmp(l, "##INFO=<ID=", 11) != 0)
+        return false;
+    const char* id = l + 11;
+    size_t idlen = strcspn(id, ",>");
+    if (stats && ((idlen == 9 && memcmp(id, "F_MISSING", 9) == 0) || (idlen == 3 && memcmp(id, "HWE", 3) == 0)))
+        return true;
+    if (idlen > 3 && id[0] == 'A' && (id[1] == 'C' || id[1] == 'N') && id[2] == '_') {
+        for (const string& g : groupnames)
+            if (idlen - 3 == g.size() && memcmp(id + 3, g.data(), g.size()) == 0)
+                return true;
+    }
+    return false;
+}
+
 int main (int argc, char **argv) {
 
     // parse args
@@ -43,14 +289,33 @@ int main (int argc, char **argv) {
     size_t macfilter = args.macfilter;
     float maffilter = args.maffilter;
     float missfilter = args.missfilter;
+    bool keep = args.keep;
+    bool reorder = args.reorder;
+    string sampleqcfilename = args.sampleqcfilename;
+    bool stats = args.stats;
+    float hwefilter = args.hwefilter;
+    string groupsfilename = args.groupsfilename;
 
     cerr << "Args:" << endl;
     cerr << "  skip ID file:  " << skipidfilename << endl;
     cerr << "  macfilter:     " << macfilter << endl;
     cerr << "  maffilter:     " << maffilter << endl;
     cerr << "  missfilter:    " << missfilter << endl;
+    cerr << "  keep:          " << keep << endl;
+    cerr << "  reorder:       " << reorder << endl;
+    if (!sampleqcfilename.empty())
+        cerr << "  sample QC:     " << sampleqcfilename << endl;
+    cerr << "  stats:         " << stats << endl;
+    cerr << "  hwefilter:     " << hwefilter << endl;
+    if (!groupsfilename.empty())
+        cerr << "  groups:        " << groupsfilename << endl;
     cerr << endl;
 
+    SampleGroups* groups = groupsfilename.empty() ? NULL : new SampleGroups(groupsfilename);
+    vector<string> groupnames;
+    if (groups)
+        groupnames = groups->names;
+
 
     FILE* skipidfile = fopen(args.skipidfilename.c_str(), "r");
 
@@ -63,14 +328,44 @@ int main (int argc, char **argv) {
 
     size_t len = BUFSIZE;
     char* line = (char*) malloc(len*sizeof(char));
-    vector<string> skipids;
+    vector<string> idlist; // sample IDs from the file in the order of the file
+    unordered_set<string> skipids; // same as a set (samples to be removed, or to be kept with --keep)
     vector<size_t> skipidxs;
 
     size_t nvars = 0;
     size_t nsamples = 0;
     size_t nskip = 0;
 
-    size_t nh = getline(&line, &len, stdin); // read first line
+    // BCF input: the header and the records are converted to VCF text, the genotypes of removed samples are not decoded
+    BcfReader bcfr;
+    bool bcf = bcfDetect(stdin);
+    if (bcf && bcfOpen(&bcfr, stdin) != 0)
+        exit(EXIT_FAILURE);
+    size_t bcfhdrpos = 0; // next line of the BCF header
+    vector<unsigned char> skipmask; // removed samples
+
+    // reads the next line from stdin (or from the BCF input), returns -1 at the end of the input
+    auto readLine = [&]() -> ssize_t {
+        if (!bcf)
+            return getline(&line, &len, stdin);
+        BcfStr out = {line, 0, len};
+        if (bcfhdrpos < bcfr.hdrlen) { // header line
+            const char* l = bcfr.hdr + bcfhdrpos;
+            const char* lend = strchr(l, '\n') + 1;
+            bcfStrAppend(&out, l, lend - l);
+            bcfhdrpos += lend - l;
+        } else if (bcfReadRecord(&bcfr) == 0) {
+            bcfFormatSite(&bcfr, &out, 1);
+            bcfFormatSamples(&bcfr, &out, NULL, 0, skipmask.empty() ? NULL : skipmask.data(), 1);
+            bcfStrAppend(&out, "\n", 1);
+        } else
+            return -1;
+        line = out.s;
+        len = out.m;
+        return out.l;
+    };
+
+    size_t nh = readLine(); // read first line
     if (nh > 0 && nh != (size_t)-1) { // contains data
 
         // copy header until #CHROM line
@@ -78,9 +373,10 @@ int main (int argc, char **argv) {
             if (string(line,6).compare("#CHROM") == 0) { // found the #CHROM line (last line of header)
                 break;
             }
-            cout << line;
+            if (!isAddedInfo(line, stats, groupnames)) // replaced by our own descriptions
+                cout << line;
 
-        } while((nh = getline(&line, &len, stdin)) != (size_t)-1);
+        } while((nh = readLine()) != (size_t)-1);
 
         // add header line indicating the use of this tool
         cout << "##removesamples_command=";
@@ -88,20 +384,37 @@ int main (int argc, char **argv) {
             cout << argv[i] << " ";
         cout << endl;
 
-        // load sample IDs that should be excluded from input file
+        // descriptions of the added INFO fields
+        if (stats) {
+            cout << "##INFO=<ID=F_MISSING,Number=1,Type=Float,Description=\"Fraction of missing genotypes, calculated by removesamples\">" << endl;
+            cout << "##INFO=<ID=HWE,Number=A,Type=Float,Description=\"Hardy-Weinberg equilibrium exact test p-value of the diploid genotypes for each alt allele, calculated by removesamples\">" << endl;
+        }
+        for (const string& g : groupnames) {
+            cout << "##INFO=<ID=AC_" << g << ",Number=A,Type=Integer,Description=\"Allele count in genotypes of group " << g << ", calculated by removesamples\">" << endl;
+            cout << "##INFO=<ID=AN_" << g << ",Number=1,Type=Integer,Description=\"Total number of alleles in called genotypes of group " << g << ", calculated by removesamples\">" << endl;
+        }
+
+        // load sample IDs that should be excluded (or kept) from input file
         {
             cerr << "Reading sample IDs from " << argv[1] << endl;
             size_t sidlen = 128;
             char* sid = (char*) malloc(sidlen*sizeof(char));
             size_t nc;
             while((nc = getline(&sid, &sidlen, skipidfile)) != (size_t)-1) {
-                skipids.push_back(string(sid, nc-1)); // discard newline char
+                if (nc && sid[nc-1] == '\n') // discard newline char
+                    nc--;
+                if (skipids.insert(string(sid, nc)).second)
+                    idlist.push_back(string(sid, nc));
             }
             fclose(skipidfile);
             free(sid);
             cerr << "Read " << skipids.size() << " sample IDs." << endl;
         }
 
+        // the gather plan: runs of kept samples in the input and their position in the output
+        vector<SampleRun> runs;
+        vector<string> outids; // kept sample IDs in the order of the output
+
         // parse the #CHROM line for all sample IDs
         {
             cerr << "Will remove the following samples found in the input stream:" << endl;
@@ -117,169 +430,179 @@ int main (int argc, char **argv) {
             else // input contains no samples
                 cout << string(line, string(line).size()-1); // discard newline at end
 
-            // parse all sample IDs and check whether they should be excluded
-            size_t curridx = 0;
+            // parse all sample IDs
+            vector<string> sampleids;
             char* se = s; // s either points to tab or is null
             while (se) {
                 s++;
                 se = strchr(s, '\t');
-                string sampleid;
                 if (se) {
-                    sampleid = string(s, se-s); // sample ID string excluding tab
+                    sampleids.push_back(string(s, se-s)); // sample ID string excluding tab
                 } else { // tab not found -> last sample
-                    sampleid = string(s); // sample ID including newline char
-                    sampleid = sampleid.substr(0, sampleid.size()-1); // removed newline char
+                    string sampleid(s); // sample ID including newline char
+                    sampleids.push_back(sampleid.substr(0, sampleid.size()-1)); // removed newline char
                 }
-                // naive search of the sample in the complete list of sample IDs to be excluded
-                bool include = true;
-                for (const auto& skipid : skipids) {
-                    if (skipid.compare(sampleid) == 0) {
-                        include = false;
-                        break;
+                s = se;
+            }
+            nsamples = sampleids.size();
+
+            // kept samples in the order of the output
+            vector<size_t> outidxs;
+            skipmask.assign(nsamples, 1);
+            if (reorder) { // order of the sample ID file
+                unordered_map<string, size_t> sampleidxs;
+                for (size_t idx = 0; idx < nsamples; idx++)
+                    sampleidxs.emplace(sampleids[idx], idx);
+                size_t nnotfound = 0;
+                for (const string& id : idlist) {
+                    auto it = sampleidxs.find(id);
+                    if (it != sampleidxs.end()) {
+                        outidxs.push_back(it->second);
+                        skipmask[it->second] = 0;
+                    } else
+                        nnotfound++;
+                }
+                if (nnotfound)
+                    cerr << "WARNING: " << nnotfound << " sample IDs to keep were not found in the input stream." << endl;
+            } else { // order of the input
+                for (size_t idx = 0; idx < nsamples; idx++) {
+                    if ((skipids.count(sampleids[idx]) != 0) == keep) {
+                        outidxs.push_back(idx);
+                        skipmask[idx] = 0;
                     }
                 }
-                // print included sample ID
-                if (include) {
-                    cout << "\t" << sampleid;
-                } else { // store index of excluded sample
-                    skipidxs.push_back(curridx);
-                    cerr << "\t" << sampleid << endl;
+            }
+
+            // store indices of excluded samples
+            for (size_t idx = 0; idx < nsamples; idx++) {
+                if (skipmask[idx]) {
+                    skipidxs.push_back(idx);
+                    cerr << "\t" << sampleids[idx] << endl;
                 }
-                curridx++;
-                s = se;
+            }
+
+            // print included sample IDs and combine consecutive samples into runs
+            for (size_t idx : outidxs) {
+                cout << "\t" << sampleids[idx];
+                if (!runs.empty() && runs.back().first + runs.back().n == idx)
+                    runs.back().n++;
+                else
+                    runs.push_back({idx, 1, runs.size(), outids.size()});
+                outids.push_back(sampleids[idx]);
             }
             // newline at end
             cout << endl;
 
-            nsamples = curridx;
+            // the runs are gathered in the order of the input
+            sort(runs.begin(), runs.end(), [](const SampleRun& a, const SampleRun& b){ return a.first < b.first; });
+
             cerr << "Read " << nsamples << " samples from header, of these " << skipidxs.size() << " will be skipped." << endl;
+
+            // map the group samples to their position in the output
+            if (groups) {
+                unordered_map<string, size_t> outidxmap;
+                for (size_t i = 0; i < outids.size(); i++)
+                    outidxmap.emplace(outids[i], i);
+                size_t nunknown = groups->assign(&outidxmap);
+                if (nunknown)
+                    cerr << "WARNING: " << nunknown << " samples from the groups file are not contained in the output." << endl;
+                cerr << "Sample groups: " << groupnames.size() << endl;
+            }
         }
 
         // parse rest of file
         cerr << "Processing..." << endl;
 
-        vector<pair<char*,char*>> outptrs;
-        outptrs.reserve(skipidxs.size()+3); // all sample blocks around the skipped samples + fields before INFO + FORMAT field after INFO
+        SampleQC qc;
+        bool withqc = !sampleqcfilename.empty();
+        if (withqc)
+            qc.init(outids.size());
+
+        // extended statistics of the kept samples
+        bool withstats = stats || hwefilter > 0 || groups;
+        VarStats vstats;
+        if (groups) {
+            vstats.groups = &groups->groups;
+            vstats.ngroups = groupnames.size();
+        }
+        vector<double> hwes;
+
+        vector<pair<char*,char*>> spans(runs.size()); // the kept sample blocks of the current line in the order of the output
+        string out; // output buffer
+        out.reserve(OUTBUFSIZE + 16 * 1024);
         ssize_t nline = 0;
-        while((nline = getline(&line, &len, stdin)) != -1) {
+        while((nline = readLine()) != -1) {
 
             size_t ac = 0;
             size_t an = 0;
             size_t missc = 0;
+            if (withqc)
+                qc.clearLine();
 
             nvars++;
             if (nvars % 10000 == 0)
                 cerr << "  " << nvars << " variants..." << endl;
 
-            outptrs.clear();
             char* lineend = line + nline; // points to the end of the line (after the newline character)
+            char* gtend = (nline && lineend[-1] == '\n') ? lineend - 1 : lineend; // end of the genotypes (the newline character)
 
-            // print everything until beginning of INFO column (8th column)
+            // find the beginning of INFO column (8th column)
             char* s = line;
+            char* alt = NULL;
             for (int t = 0; t < 7; t++) {
                 s = strchr(s+1, '\t');
+                if (t == 3)
+                    alt = s+1; // ALT column
             }
             s++; // points to beginning of INFO column now
-            outptrs.emplace_back(line, s); // will print the beginning until INFO including tab character at end
-
-//            // DEBUG
-//            cerr << string(line, s-line);
+            char* info = s;
 
             s = strchr(s, '\t'); // move forward to end of INFO (skips INFO, points to tab before FORMAT now)
+            if (!s) // no FORMAT column
+                s = gtend;
 
-            char* se = strchr(s+1, '\t'); // is either NULL (no samples) or points to tab before first sample
+            char* se = s < gtend ? (char*) memchr(s+1, '\t', gtend-s-1) : NULL; // is either NULL (no samples) or points to tab before first sample
             if (!se)
-                se = lineend;
-
-            // include the FORMAT field as first block for the output
-            outptrs.emplace_back(s, se);
-            s = se;
-
-            // parse the rest of the line, count alleles and skip samples from list
-            size_t curridx = 0;
-            auto skipidxit = skipidxs.cbegin();
-            size_t nextskipidx;
-            // set next skip idx to number of samples if nothing to skip
-            if (skipidxit != skipidxs.cend()) {
-                nextskipidx = *skipidxit;
-                skipidxit++; // always points to the next one after the current
-            } else
-                nextskipidx = nsamples;
-            while (s < lineend) {
-
-                char* sc = s; // tab before sample column
-                while (curridx < nextskipidx) { // until we reach the next sample to skip (or until we handled the last sample)
-
-                    sc++; // first character of sample column
-
-                    // find end of current sample column first
-                    char* sce = strchr(sc, '\t');
-                    if (!sce)
-                        sce = lineend;
-
-                    // for further parsing, we need to temporarily replace the end by the null character (if we are at the end, it points to null anyway)
-                    *sce = '\0';
-
-                    // we assume the first character represents the first allele, all alleles different from 0 or missing (.) are counted
-                    if (*sc != '.') {
-                        if (*sc != '0')
-                            ac++;
-                        an++;
-                    } else
-                        missc++;
-
-                    // diploid and phased?
-                    char* sc2 = strchr(sc, '|');
-                    if (sc2) { // found -> count
-                        sc2++; // points to allele
-                        if (*sc2 != '.') {
-                            if (*sc2 != '0')
-                                ac++;
-                        } else
-                            missc++;
-                        an++;
-                    } else { // not found -> search for unphased
-                        sc2 = strchr(sc, '/');
-                        if (sc2) { // found -> count
-                            sc2++; // points to allele
-                            if (*sc2 != '.') {
-                                if (*sc2 != '0')
-                                    ac++;
-                            } else
-                                missc++;
-                            an++;
-                        }
-                    }
-
-                    // restore the tab character
-                    if (sce != lineend)
-                        *sce = '\t';
-
-                    sc = sce;
-                    curridx++;
-                } // END while (curridx < nextskipidx)
-
-                // insert block for output
-                outptrs.emplace_back(s, sc);
-                s = sc;
-
-                // skip the next sample (if we are not at the end yet)
-                if (s < lineend) {
-                    // find end of sample column
-                    s = strchr(s+1, '\t');
-                    if (!s)
-                        s = lineend;
-                    curridx++;
+                se = gtend;
+            bool gtonly = se - s == 3 && s[1] == 'G' && s[2] == 'T'; // no further fields in the sample columns
+
+            // BCF input: the alleles are counted directly from the typed GT values instead of the formatted text
+            // (not with the sample QC, which classifies the formatted genotypes)
+            bool bcfcounted = false;
+            if (bcf && !withqc) {
+                int gttype;
+                size_t gtn;
+                const unsigned char* gt = bcfFormatField(&bcfr, "GT", &gttype, &gtn);
+                if (gt) {
+                    bcfcounted = true;
+                    if (gttype == BCF_BT_INT8)
+                        countBcfGT<int8_t>(gt, gtn, nsamples, skipmask.data(), ac, an, missc);
+                    else if (gttype == BCF_BT_INT16)
+                        countBcfGT<int16_t>(gt, gtn, nsamples, skipmask.data(), ac, an, missc);
+                    else if (gttype == BCF_BT_INT32)
+                        countBcfGT<int32_t>(gt, gtn, nsamples, skipmask.data(), ac, an, missc);
+                    else
+                        bcfcounted = false;
                 }
+            }
 
-                // set next index to skip
-                if (skipidxit != skipidxs.cend()) {
-                    nextskipidx = *skipidxit;
-                    skipidxit++;
-                } else
-                    nextskipidx = nsamples;
-
-            } // END while (s < lineend)
+            // scan the sample runs: count alleles and store the blocks for the output
+            char* sc = se;
+            size_t curridx = 0;
+            for (const SampleRun& run : runs) {
+                // skip the samples before the run
+                sc = skipColumns(sc, run.first - curridx, gtend);
+                curridx = run.first;
+                char* runstart = sc;
+                if (bcfcounted) // only the end of the run is required
+                    sc = skipColumns(sc, run.n, gtend);
+                else if (withqc)
+                    sc = countRun<true>(sc, run.n, gtend, lineend, gtonly, ac, an, missc, &qc, run.outidx);
+                else
+                    sc = countRun<false>(sc, run.n, gtend, lineend, gtonly, ac, an, missc, NULL, 0);
+                curridx += run.n;
+                spans[run.out] = make_pair(runstart, sc);
+            }
 
             // apply filters
             bool pass = true;
@@ -287,27 +610,87 @@ int main (int argc, char **argv) {
                 pass = false;
             if (maffilter && ((float)ac)/an < maffilter)
                 pass = false;
-            if (missfilter && ((float)missc)/an >= missfilter)
+            if (missfilter && ((float)missc)/(an+missc) >= missfilter)
                 pass = false;
 
+            // extended statistics from the kept genotypes
+            if (pass && withstats) {
+                size_t nalt = 1;
+                for (const char* a = alt; *a != '\t'; a++)
+                    if (*a == ',')
+                        nalt++;
+                vstats.reset(nalt);
+                for (const SampleRun& run : runs) {
+                    const auto& span = spans[run.out];
+                    if (span.first < span.second)
+                        scanStats(vstats, span.first+1, span.second, run.outidx);
+                }
+                hwes.resize(nalt);
+                for (size_t a = 0; a < nalt; a++) {
+                    hwes[a] = vstats.hwe(a);
+                    if (hwes[a] < hwefilter)
+                        pass = false;
+                }
+            }
+
             // print if filters passed
             if (pass) {
 
-                auto outit = outptrs.cbegin();
+                if (withqc)
+                    qc.applyLine(ac);
 
-                // print first fields (before INFO, block already contains the tab character at the end)
-                cout << string(outit->first, outit->second - outit->first);
-                outit++;
+                // first fields (before INFO, including the tab character at the end)
+                out.append(line, info);
 
-                // print INFO field now
-                cout << "AC=" << ac << ";AN=" << an;
+                // INFO field
+                char num[24];
+                out.append("AC=");
+                if (stats) { // for each alt allele
+                    for (size_t a = 0; a < vstats.nalt; a++) {
+                        if (a)
+                            out.push_back(',');
+                        out.append(num, to_chars(num, num+sizeof(num), vstats.ac[a]).ptr);
+                    }
+                } else
+                    out.append(num, to_chars(num, num+sizeof(num), ac).ptr);
+                out.append(";AN=");
+                out.append(num, to_chars(num, num+sizeof(num), an).ptr);
+                if (stats) {
+                    out.append(";F_MISSING=");
+                    appendFloatG(out, vstats.fmissing());
+                    out.append(";HWE=");
+                    for (size_t a = 0; a < vstats.nalt; a++) {
+                        if (a)
+                            out.push_back(',');
+                        appendFloatG(out, hwes[a]);
+                    }
+                }
+                for (size_t g = 0; g < vstats.ngroups; g++) {
+                    out.append(";AC_");
+                    out.append(groupnames[g]);
+                    out.push_back('=');
+                    for (size_t a = 0; a < vstats.nalt; a++) {
+                        if (a)
+                            out.push_back(',');
+                        out.append(num, to_chars(num, num+sizeof(num), vstats.groupac[g * vstats.nalt + a]).ptr);
+                    }
+                    out.append(";AN_");
+                    out.append(groupnames[g]);
+                    out.push_back('=');
+                    out.append(num, to_chars(num, num+sizeof(num), vstats.groupan[g]).ptr);
+                }
 
-    //            // DEBUG
-    //            cerr << "AC=" << ac << ";AN=" << an << endl;
+                // FORMAT field and all sample blocks (all blocks begin with a tab)
+                out.append(s, se);
+                for (const auto& span : spans)
+                    out.append(span.first, span.second);
+                out.push_back('\n');
 
-                // print all remaining blocks (all blocks should begin with a tab, the last block should contain the newline character)
-                for (; outit != outptrs.cend(); ++outit)
-                    cout << string(outit->first, outit->second - outit->first);
+                if (out.size() >= OUTBUFSIZE) {
+                    cout << flush;
+                    fwrite(out.data(), 1, out.size(), stdout);
+                    out.clear();
+                }
 
             } else // if (!pass)
                 nskip++;
@@ -315,6 +698,29 @@ int main (int argc, char **argv) {
         } // END while(getline)
 
         cout << flush;
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+
+        // write the per-sample QC table
+        if (withqc) {
+            ofstream qcfile(sampleqcfilename);
+            if (!qcfile) {
+                cerr << "ERROR: Unable to open file " << sampleqcfilename << " for writing." << endl;
+                exit(EXIT_FAILURE);
+            }
+            size_t nout = nvars - nskip;
+            qcfile << "#SAMPLE\tN_VARIANTS\tN_HOMREF\tN_HET\tN_HOMALT\tN_MISSING\tF_MISSING\tN_SINGLETON\n";
+            for (size_t i = 0; i < outids.size(); i++) {
+                qcfile << outids[i] << '\t' << nout
+                        << '\t' << nout - qc.nhet[i] - qc.nhomalt[i] - qc.nmiss[i]
+                        << '\t' << qc.nhet[i]
+                        << '\t' << qc.nhomalt[i]
+                        << '\t' << qc.nmiss[i]
+                        << '\t' << (nout ? qc.nmiss[i] / (double) nout : 0.0)
+                        << '\t' << qc.nsingleton[i] << '\n';
+            }
+            cerr << "Wrote per-sample QC statistics to " << sampleqcfilename << endl;
+        }
 
     } // END contains data
 
@@ -322,7 +728,10 @@ int main (int argc, char **argv) {
     cerr << " Of these skipped due to applied filters: " << nskip << endl;
     cerr << " Total variants in output:                " << nvars - nskip << endl;
 
+    if (bcf)
+        bcfClose(&bcfr);
     free(line);
+    if (groups)
+        delete groups;
 
 }
-
@@ -0,0 +1,494 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "Bcf.h"
+#include "NumParse.h"
+
+// BCF2 types of typed values
+#define BCF_BT_NULL  0
+#define BCF_BT_INT8  1
+#define BCF_BT_INT16 2
+#define BCF_BT_INT32 3
+#define BCF_BT_FLOAT 5
+#define BCF_BT_CHAR  7
+
+// special integer values (as int32, converted to the width of the type when written)
+#define BCF_INT_MISSING    INT32_MIN
+#define BCF_INT_VECTOR_END (INT32_MIN+1)
+// missing float
+#define BCF_FLOAT_MISSING  0x7F800001u
+
+// all values are written in little endian
+
+static inline void setLE32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (char) ((v >> (8*i)) & 0xff);
+}
+
+static inline void putLE32(string& s, uint32_t v) {
+    char b[4] = { (char) (v & 0xff), (char) ((v >> 8) & 0xff), (char) ((v >> 16) & 0xff), (char) (v >> 24) };
+    s.append(b, 4);
+}
+
+// writes an integer with the width of the given type, the special values are mapped to the type
+static inline void putInt(string& s, int32_t v, int type) {
+    if (type == BCF_BT_INT8) {
+        if (v == BCF_INT_MISSING)
+            v = INT8_MIN;
+        else if (v == BCF_INT_VECTOR_END)
+            v = INT8_MIN+1;
+        s.push_back((char) v);
+    } else if (type == BCF_BT_INT16) {
+        if (v == BCF_INT_MISSING)
+            v = INT16_MIN;
+        else if (v == BCF_INT_VECTOR_END)
+            v = INT16_MIN+1;
+        s.push_back((char) (v & 0xff));
+        s.push_back((char) ((v >> 8) & 0xff));
+    } else
+        putLE32(s, (uint32_t) v);
+}
+
+// smallest integer type for the given range (the lowest values of each type are reserved)
+static inline int intType(int32_t min, int32_t max) {
+    if (max <= INT8_MAX && min >= INT8_MIN+8)
+        return BCF_BT_INT8;
+    if (max <= INT16_MAX && min >= INT16_MIN+8)
+        return BCF_BT_INT16;
+    return BCF_BT_INT32;
+}
+
+// type byte of a typed value with n elements (followed by the length as typed integer for n >= 15)
+static void encSize(string& s, size_t n, int type) {
+    if (n < 15)
+        s.push_back((char) (n << 4 | type));
+    else {
+        s.push_back((char) (15 << 4 | type));
+        int t = intType(0, n);
+        s.push_back((char) (1 << 4 | t));
+        putInt(s, n, t);
+    }
+}
+
+// single typed integer
+static void encInt1(string& s, int32_t v) {
+    int t = intType(v, v);
+    s.push_back((char) (1 << 4 | t));
+    putInt(s, v, t);
+}
+
+// typed integer vector
+static void encInts(string& s, const int32_t* a, size_t n) {
+    if (n == 0) {
+        encSize(s, 0, BCF_BT_NULL);
+        return;
+    }
+    int32_t min = INT32_MAX, max = INT32_MIN;
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] == BCF_INT_MISSING || a[i] == BCF_INT_VECTOR_END)
+            continue;
+        min = a[i] < min ? a[i] : min;
+        max = a[i] > max ? a[i] : max;
+    }
+    int t = max < min ? BCF_BT_INT8 : intType(min, max);
+    encSize(s, n, t);
+    for (size_t i = 0; i < n; i++)
+        putInt(s, a[i], t);
+}
+
+// typed float vector
+static void encFloats(string& s, const float* a, size_t n) {
+    encSize(s, n, BCF_BT_FLOAT);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t u;
+        if (a[i] != a[i]) // NaN is written as missing
+            u = BCF_FLOAT_MISSING;
+        else
+            memcpy(&u, &a[i], 4);
+        putLE32(s, u);
+    }
+}
+
+// typed character vector
+static void encChars(string& s, const char* c, size_t n) {
+    encSize(s, n, BCF_BT_CHAR);
+    s.append(c, n);
+}
+
+// returns the value of the given attribute of a structured header line (e.g. "##INFO=<ID=AF,...>") or an empty string
+static string attr(const string& l, const string& key) {
+    size_t p = l.find('<');
+    while (p != string::npos && p < l.size()) {
+        p++;
+        size_t eq = l.find('=', p);
+        if (eq == string::npos)
+            break;
+        size_t vend = eq + 1;
+        if (vend < l.size() && l[vend] == '"') { // quoted value
+            vend = l.find('"', vend + 1);
+            while (vend != string::npos && l[vend-1] == '\\')
+                vend = l.find('"', vend + 1);
+            if (vend == string::npos)
+                break;
+            vend++;
+        }
+        vend = l.find_first_of(",>", vend);
+        if (vend == string::npos)
+            vend = l.size();
+        if (l.compare(p, eq - p, key) == 0)
+            return l.substr(eq + 1, vend - eq - 1);
+        p = vend;
+    }
+    return "";
+}
+
+BcfHeader::BcfHeader(const string& vcfheader, const string& chrom, bool gq) :
+    contig(-1), afid(-1), acid(-1), anid(-1), gtid(-1), gqid(-1), nsamples(0)
+{
+    // split into lines and check which of the required lines are present
+    vector<string> lines;
+    bool haspass = false, hascontig = false, hasgt = false, hasgq = false;
+    for (size_t start = 0; start < vcfheader.size(); ) {
+        size_t end = vcfheader.find('\n', start);
+        if (end == string::npos)
+            end = vcfheader.size();
+        lines.push_back(vcfheader.substr(start, end - start));
+        const string& l = lines.back();
+        if (l.compare(0, 10, "##FILTER=<") == 0)
+            haspass |= attr(l, "ID") == "PASS";
+        else if (l.compare(0, 10, "##contig=<") == 0)
+            hascontig |= attr(l, "ID") == chrom;
+        else if (l.compare(0, 10, "##FORMAT=<") == 0) {
+            hasgt |= attr(l, "ID") == "GT";
+            hasgq |= attr(l, "ID") == "GQ";
+        }
+        start = end + 1;
+    }
+
+    // header text with all required lines
+    if (lines.empty() || lines[0].compare(0, 13, "##fileformat=") != 0)
+        lines.insert(lines.begin(), "##fileformat=VCFv4.2");
+    if (!haspass)
+        lines.insert(lines.begin() + 1, "##FILTER=<ID=PASS,Description=\"All filters passed\">");
+    for (const string& l : lines) {
+        if (l.compare(0, 6, "#CHROM") == 0) {
+            if (!hascontig)
+                text.append("##contig=<ID=" + chrom + ">\n");
+            if (!hasgt)
+                text.append("##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n");
+            if (gq && !hasgq)
+                text.append("##FORMAT=<ID=GQ,Number=1,Type=Integer,Description=\"Genotype Quality\">\n");
+        }
+        text.append(l);
+        text.push_back('\n');
+    }
+
+    // dictionaries
+    unordered_map<string, int32_t> dict; // common dictionary of FILTER, INFO and FORMAT IDs
+    dict["PASS"] = 0;
+    int32_t next = 1;
+    int32_t nextcontig = 0;
+    for (size_t start = 0; start < text.size(); ) {
+        size_t end = text.find('\n', start);
+        string l = text.substr(start, end - start);
+        start = end + 1;
+
+        bool isfilter = l.compare(0, 10, "##FILTER=<") == 0;
+        bool isinfo = l.compare(0, 8, "##INFO=<") == 0;
+        bool isformat = l.compare(0, 10, "##FORMAT=<") == 0;
+        if (isfilter || isinfo || isformat) {
+            string id = attr(l, "ID");
+            string idx = attr(l, "IDX");
+            int32_t num;
+            auto it = dict.find(id);
+            if (it != dict.end())
+                num = it->second;
+            else {
+                num = idx.empty() ? next : atoi(idx.c_str());
+                dict[id] = num;
+                next = max(next, num + 1);
+            }
+            if (isfilter) {
+                keys.push_back(id);
+                filters[keys.back()] = num;
+            } else if (isinfo) {
+                string type = attr(l, "Type");
+                Type t = type == "Integer" ? INTEGER : type == "Float" ? FLOAT : type == "Flag" ? FLAG : STRING;
+                keys.push_back(id);
+                infos[keys.back()] = Info{num, t};
+            } else if (id == "GT")
+                gtid = num;
+            else if (id == "GQ" && gq)
+                gqid = num;
+
+        } else if (l.compare(0, 10, "##contig=<") == 0) {
+            string idx = attr(l, "IDX");
+            int32_t num = idx.empty() ? nextcontig : atoi(idx.c_str());
+            nextcontig = max(nextcontig, num + 1);
+            if (attr(l, "ID") == chrom)
+                contig = num;
+
+        } else if (l.compare(0, 6, "#CHROM") == 0) {
+            size_t ntabs = count(l.begin(), l.end(), '\t');
+            nsamples = ntabs > 8 ? ntabs - 8 : 0;
+        }
+    }
+    filters["PASS"] = 0;
+
+    const Info* i;
+    if ((i = info("AF", 2)))
+        afid = i->id;
+    if ((i = info("AC", 2)))
+        acid = i->id;
+    if ((i = info("AN", 2)))
+        anid = i->id;
+}
+
+string BcfHeader::encode() const {
+    string s("BCF\2\2", 5);
+    putLE32(s, text.size() + 1);
+    s.append(text);
+    s.push_back('\0');
+    return s;
+}
+
+void BcfRecord::begin(const BcfHeader& hdr_, const char* pos, const char* posend, const char* id, const char* idend,
+        const char* ref, const char* refend, const char* qual, const char* qualend) {
+    hdr = &hdr_;
+    shared.clear();
+    indiv.clear();
+    nallele = 1;
+    ninfo = 0;
+    nfmt = 0;
+
+    size_t p;
+    posval = parseUInt(pos, posend, p) ? (int32_t) p - 1 : -1; // 0-based
+    rlen = refend - ref;
+
+    // CHROM, POS, rlen and the counts are set in end()
+    shared.resize(12);
+    float q;
+    uint32_t qbits = BCF_FLOAT_MISSING;
+    if (parseFloat(qual, qualend, q))
+        memcpy(&qbits, &q, 4);
+    putLE32(shared, qbits);
+    shared.resize(24);
+
+    if (idend - id == 1 && *id == '.')
+        encSize(shared, 0, BCF_BT_CHAR);
+    else
+        encChars(shared, id, idend - id);
+    encChars(shared, ref, refend - ref);
+}
+
+void BcfRecord::addAllele(const char* a, const char* aend) {
+    encChars(shared, a, aend - a);
+    nallele++;
+}
+
+void BcfRecord::setFilter(const char* f, const char* fend) {
+    ivals.clear();
+    if (!(fend - f == 1 && *f == '.')) {
+        while (f < fend) {
+            const char* e = (const char*) memchr(f, ';', fend - f);
+            if (e == NULL)
+                e = fend;
+            int32_t id = hdr->filter(f, e - f);
+            if (id >= 0)
+                ivals.push_back(id);
+            else
+                nundefined++;
+            f = e + 1;
+        }
+    }
+    encInts(shared, ivals.data(), ivals.size());
+}
+
+void BcfRecord::addInfoFloats(int32_t id, const float* vals, size_t n) {
+    if (id < 0)
+        return;
+    encInt1(shared, id);
+    encFloats(shared, vals, n);
+    ninfo++;
+}
+
+void BcfRecord::addInfoInts(int32_t id, const size_t* vals, size_t n) {
+    if (id < 0)
+        return;
+    ivals.clear();
+    for (size_t i = 0; i < n; i++)
+        ivals.push_back(vals[i] <= INT32_MAX ? (int32_t) vals[i] : BCF_INT_MISSING);
+    encInt1(shared, id);
+    encInts(shared, ivals.data(), ivals.size());
+    ninfo++;
+}
+
+void BcfRecord::addInfo(const char* key, size_t keylen, const char* val, const char* end) {
+    const BcfHeader::Info* info = hdr->info(key, keylen);
+    if (info == NULL) {
+        nundefined++;
+        return;
+    }
+    encInt1(shared, info->id);
+    switch (info->type) {
+    case BcfHeader::FLAG:
+        encSize(shared, 0, BCF_BT_NULL);
+        break;
+    case BcfHeader::STRING:
+        encChars(shared, val, end - val);
+        break;
+    case BcfHeader::INTEGER:
+        ivals.clear();
+        do {
+            const char* e = (const char*) memchr(val, ',', end - val);
+            if (e == NULL)
+                e = end;
+            int32_t v;
+            ivals.push_back(parseInt(val, e, v) ? v : BCF_INT_MISSING);
+            val = e + 1;
+        } while (val <= end);
+        encInts(shared, ivals.data(), ivals.size());
+        // END determines the length of the reference allele
+        if (keylen == 3 && memcmp(key, "END", 3) == 0 && ivals.size() == 1 && ivals[0] != BCF_INT_MISSING)
+            rlen = ivals[0] - posval;
+        break;
+    case BcfHeader::FLOAT:
+        fvals.clear();
+        do {
+            const char* e = (const char*) memchr(val, ',', end - val);
+            if (e == NULL)
+                e = end;
+            float v;
+            fvals.push_back(parseFloat(val, e, v) ? v : NAN);
+            val = e + 1;
+        } while (val <= end);
+        encFloats(shared, fvals.data(), fvals.size());
+        break;
+    }
+    ninfo++;
+}
+
+void BcfRecord::setGenotypes(const char* gt, const char* gtend) {
+    if (hdr->nsamples == 0)
+        return;
+    gtvals.clear();
+    ploidy.clear();
+    gqvals.clear();
+    unsigned char maxploidy = 0;
+    int32_t maxgt = 0;
+
+    const char* p = gt;
+    while (p < gtend && *p != '\n') { // for each sample
+        unsigned char pl = 0;
+        int32_t phased = 0; // the phasing bit belongs to the allele following the separator
+        for (;;) {
+            int32_t v = 0; // missing allele
+            if (p < gtend && *p >= '0' && *p <= '9') {
+                int32_t idx = 0;
+                for (; p < gtend && *p >= '0' && *p <= '9'; p++)
+                    idx = idx * 10 + (*p - '0');
+                v = (idx + 1) << 1;
+            } else if (p < gtend && *p == '.')
+                p++;
+            v |= phased;
+            maxgt = v > maxgt ? v : maxgt;
+            gtvals.push_back(v);
+            pl++;
+            if (p < gtend && (*p == '|' || *p == '/')) {
+                phased = *p == '|';
+                p++;
+            } else
+                break;
+        }
+        if (hdr->gqid >= 0) {
+            int32_t gq = BCF_INT_MISSING;
+            if (p < gtend && *p == ':') {
+                const char* q = ++p;
+                while (p < gtend && *p != '\t' && *p != '\n' && *p != ':')
+                    p++;
+                if (!parseInt(q, p, gq))
+                    gq = BCF_INT_MISSING;
+            }
+            gqvals.push_back(gq);
+        }
+        // skip any further fields
+        while (p < gtend && *p != '\t' && *p != '\n')
+            p++;
+        ploidy.push_back(pl);
+        maxploidy = pl > maxploidy ? pl : maxploidy;
+        if (p < gtend && *p == '\t')
+            p++;
+    }
+    if (ploidy.size() != hdr->nsamples) {
+        cerr << "ERROR: Number of samples in a line (" << ploidy.size() << ") does not match the header (" << hdr->nsamples << ")." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // GT: alleles of each sample padded to the maximum ploidy
+    encInt1(indiv, hdr->gtid);
+    int t = intType(0, maxgt);
+    encSize(indiv, maxploidy, t);
+    const int32_t* v = gtvals.data();
+    for (unsigned char pl : ploidy) {
+        for (unsigned char i = 0; i < pl; i++)
+            putInt(indiv, *v++, t);
+        for (unsigned char i = pl; i < maxploidy; i++)
+            putInt(indiv, BCF_INT_VECTOR_END, t);
+    }
+    nfmt = 1;
+
+    // GQ: one value per sample
+    if (hdr->gqid >= 0) {
+        int32_t min = INT32_MAX, max = INT32_MIN;
+        for (int32_t gq : gqvals) {
+            if (gq == BCF_INT_MISSING)
+                continue;
+            min = gq < min ? gq : min;
+            max = gq > max ? gq : max;
+        }
+        t = max < min ? BCF_BT_INT8 : intType(min, max);
+        encInt1(indiv, hdr->gqid);
+        encSize(indiv, 1, t);
+        for (int32_t gq : gqvals)
+            putInt(indiv, gq, t);
+        nfmt = 2;
+    }
+}
+
+void BcfRecord::end(string& out) {
+    // fixed fields
+    setLE32(&shared[0], hdr->contig);
+    setLE32(&shared[4], posval);
+    setLE32(&shared[8], rlen);
+    setLE32(&shared[16], nallele << 16 | ninfo);
+    setLE32(&shared[20], nfmt << 24 | hdr->nsamples);
+
+    putLE32(out, shared.size());
+    putLE32(out, indiv.size());
+    out.append(shared);
+    out.append(indiv);
+}
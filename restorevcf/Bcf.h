@@ -0,0 +1,146 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BCF_H_
+#define BCF_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Dictionaries of a VCF header required for encoding BCF2 records.
+ * The IDs are assigned in the same way htslib does when reading the header:
+ * PASS is always the first filter, FILTER/INFO/FORMAT IDs share one dictionary
+ * numbered by first appearance (unless an IDX attribute is given), contigs have their own.
+ */
+class BcfHeader {
+public:
+
+    enum Type : char { FLAG, INTEGER, FLOAT, STRING };
+
+    struct Info {
+        int32_t id;
+        Type type;
+    };
+
+    /**
+     * @param vcfheader complete VCF header (all lines including #CHROM, each terminated by a newline)
+     * @param chrom the chromosome of all records, a contig line is added if it is not declared in the header
+     * @param gq set, if the records contain the GQ field, a description is added if required (as for GT)
+     */
+    BcfHeader(const string& vcfheader, const string& chrom, bool gq);
+
+    BcfHeader(const BcfHeader&) = delete;
+    BcfHeader& operator=(const BcfHeader&) = delete;
+
+    /** Returns the encoded BCF header (including the magic string) to be written at the beginning of the BCF stream. */
+    string encode() const;
+
+    /** Returns the INFO field with the given key or NULL if it is not defined in the header. */
+    const Info* info(const char* key, size_t keylen) const {
+        auto it = infos.find(string_view(key, keylen));
+        return it == infos.end() ? NULL : &it->second;
+    }
+
+    /** Returns the ID of the given filter or -1 if it is not defined in the header. */
+    int32_t filter(const char* f, size_t len) const {
+        auto it = filters.find(string_view(f, len));
+        return it == filters.end() ? -1 : it->second;
+    }
+
+    string text;       /**< header text as written to the BCF */
+    int32_t contig;    /**< ID of the chromosome */
+    int32_t afid, acid, anid; /**< IDs of the recalculated INFO fields */
+    int32_t gtid, gqid; /**< IDs of the FORMAT fields, gqid is -1 if GQ is not contained */
+    size_t nsamples;   /**< number of samples in the #CHROM line */
+
+private:
+    deque<string> keys; // storage for the keys of the maps below (a deque does not move its elements)
+    unordered_map<string_view, Info> infos;
+    unordered_map<string_view, int32_t> filters;
+};
+
+/**
+ * Encodes a single BCF2 record from the fields of a VCF line.
+ * The fields have to be provided in the order of the record: begin(), all alleles,
+ * setFilter(), the INFO fields, setGenotypes() and finally end(), which appends the record to the output.
+ * An instance keeps its own working memory, so it should not be shared between threads.
+ */
+class BcfRecord {
+public:
+
+    /** Starts a new record with the fixed fields POS, ID, REF and QUAL. */
+    void begin(const BcfHeader& hdr, const char* pos, const char* posend, const char* id, const char* idend,
+            const char* ref, const char* refend, const char* qual, const char* qualend);
+
+    /** Adds an alternative allele. */
+    void addAllele(const char* a, const char* aend);
+
+    /** Sets the FILTER column (semicolon separated list of filters or '.'). */
+    void setFilter(const char* f, const char* fend);
+
+    /** Adds an INFO field with float values. */
+    void addInfoFloats(int32_t id, const float* vals, size_t n);
+
+    /** Adds an INFO field with integer values. */
+    void addInfoInts(int32_t id, const size_t* vals, size_t n);
+
+    /**
+     * Adds an INFO field from its text representation, the values are converted to the type declared in the header.
+     * For flags, val is equal to end.
+     */
+    void addInfo(const char* key, size_t keylen, const char* val, const char* end);
+
+    /**
+     * Sets the genotypes (and GQ values) of all samples from the text representation
+     * (samples separated by tabs, the genotypes end with a newline or at gtend).
+     */
+    void setGenotypes(const char* gt, const char* gtend);
+
+    /** Finishes the record and appends it to the output. */
+    void end(string& out);
+
+    /** number of INFO values and filters that were dropped as they are not defined in the header */
+    size_t nundefined = 0;
+
+private:
+    const BcfHeader* hdr = NULL;
+    string shared;        // shared part of the record
+    string indiv;         // genotype part of the record
+    uint32_t nallele = 0;
+    uint32_t ninfo = 0;
+    uint32_t nfmt = 0;
+    int32_t rlen = 0;
+    int32_t posval = 0;
+    vector<int32_t> ivals;   // working memory for integer vectors
+    vector<float> fvals;     // working memory for float vectors
+    vector<int32_t> gtvals;  // encoded alleles of all samples
+    vector<unsigned char> ploidy; // number of alleles of each sample
+    vector<int32_t> gqvals;  // GQ of each sample
+};
+
+#endif /* BCF_H_ */
@@ -0,0 +1,156 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include <zlib.h>
+
+#include "Bgzf.h"
+
+const char bgzfEOF[28] = {
+        '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff', '\x06', 0, 'B', 'C', '\x02', 0, '\x1b', 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static inline void putLE16(char* p, uint16_t v) {
+    p[0] = (char) (v & 0xff);
+    p[1] = (char) (v >> 8);
+}
+
+static inline void putLE32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (char) ((v >> (8*i)) & 0xff);
+}
+
+void bgzfCompress(string& out, const char* data, size_t size, vector<uint32_t>* bsizes) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // raw deflate, the gzip header and trailer are written here
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        cerr << "ERROR: Failed to initialize zlib." << endl;
+        exit(EXIT_FAILURE);
+    }
+    for (size_t off = 0; off < size; off += BGZF_BLOCKSIZE) {
+        size_t n = min((size_t) BGZF_BLOCKSIZE, size - off);
+        size_t hdrpos = out.size();
+        size_t bound = deflateBound(&zs, n);
+        out.resize(hdrpos + 18 + bound + 8);
+        char* blk = &out[hdrpos];
+
+        // header with the extra field "BC" holding the block size
+        const char hdr[16] = { '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff', '\x06', 0, 'B', 'C', '\x02', 0 };
+        memcpy(blk, hdr, 16);
+
+        deflateReset(&zs);
+        zs.next_in = (Bytef*) (data + off);
+        zs.avail_in = n;
+        zs.next_out = (Bytef*) (blk + 18);
+        zs.avail_out = bound;
+        if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+            cerr << "ERROR: BGZF compression failed." << endl;
+            exit(EXIT_FAILURE);
+        }
+        size_t clen = bound - zs.avail_out;
+        size_t bsize = 18 + clen + 8;
+        putLE16(blk + 16, bsize - 1);
+        putLE32(blk + 18 + clen, crc32(crc32(0L, Z_NULL, 0), (const Bytef*) (data + off), n));
+        putLE32(blk + 18 + clen + 4, n);
+        out.resize(hdrpos + bsize);
+        if (bsizes)
+            bsizes->push_back(bsize);
+    }
+    deflateEnd(&zs);
+}
+
+BgzfWriter::BgzfWriter(FILE* out_, ThreadPool* pool_) :
+    out(out_),
+    pool(pool_),
+    buffer(make_shared<Chunk>())
+{
+    buffer->in.reserve(BGZF_TASKBLOCKS * BGZF_BLOCKSIZE);
+}
+
+BgzfWriter::~BgzfWriter() {
+    if (!closed)
+        close();
+}
+
+void BgzfWriter::write(const char* data, size_t size) {
+    const size_t chunksize = BGZF_TASKBLOCKS * BGZF_BLOCKSIZE;
+    while (size > 0) {
+        size_t n = min(size, chunksize - buffer->in.size());
+        buffer->in.append(data, n);
+        data += n;
+        size -= n;
+        uoffset += n;
+        if (buffer->in.size() == chunksize)
+            flushBuffer();
+    }
+}
+
+void BgzfWriter::flushBuffer() {
+    if (buffer->in.empty())
+        return;
+    shared_ptr<Chunk> c = buffer;
+    if (pool) {
+        if (inflight.size() >= 2 * pool->size())
+            writeFront();
+        future<void> f = pool->submit([c]() {
+            bgzfCompress(c->out, c->in.data(), c->in.size(), &c->bsizes);
+        });
+        inflight.emplace_back(c, std::move(f));
+    } else {
+        bgzfCompress(c->out, c->in.data(), c->in.size(), &c->bsizes);
+        writeChunk(*c);
+    }
+    buffer = make_shared<Chunk>();
+    buffer->in.reserve(BGZF_TASKBLOCKS * BGZF_BLOCKSIZE);
+}
+
+void BgzfWriter::writeChunk(const Chunk& c) {
+    fwrite(c.out.data(), 1, c.out.size(), out);
+    for (uint32_t b : c.bsizes) {
+        blockoffsets.push_back(coffset);
+        coffset += b;
+    }
+}
+
+void BgzfWriter::writeFront() {
+    inflight.front().second.get();
+    writeChunk(*inflight.front().first);
+    inflight.pop_front();
+}
+
+uint64_t BgzfWriter::virtualOffset(uint64_t upos) const {
+    uint64_t block = upos / BGZF_BLOCKSIZE;
+    if (block >= blockoffsets.size()) // end of the data: beginning of the EOF block
+        return coffset << 16;
+    return blockoffsets[block] << 16 | (upos % BGZF_BLOCKSIZE);
+}
+
+void BgzfWriter::close() {
+    flushBuffer();
+    while (!inflight.empty())
+        writeFront();
+    fwrite(bgzfEOF, 1, sizeof(bgzfEOF), out);
+    closed = true;
+}
@@ -0,0 +1,107 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGZF_H_
+#define BGZF_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// size of the uncompressed data in a BGZF block (same as bgzip)
+#define BGZF_BLOCKSIZE 65280
+// number of blocks compressed by a single task
+#define BGZF_TASKBLOCKS 16
+
+using namespace std;
+
+/**
+ * Writes a BGZF compressed stream (blocked gzip, as created by bgzip) to a file.
+ * The data is cut into blocks of BGZF_BLOCKSIZE bytes. If a thread pool is provided,
+ * the blocks are compressed concurrently on its workers and written in order.
+ */
+class BgzfWriter {
+public:
+    /**
+     * @param out output file (not closed by the writer)
+     * @param pool if not NULL, the compression runs on the workers of this pool
+     */
+    BgzfWriter(FILE* out, ThreadPool* pool = NULL);
+    ~BgzfWriter();
+
+    BgzfWriter(const BgzfWriter&) = delete;
+    BgzfWriter& operator=(const BgzfWriter&) = delete;
+
+    /** Appends data to the stream. */
+    void write(const char* data, size_t size);
+
+    /** Compresses and writes all remaining data followed by the BGZF EOF marker. */
+    void close();
+
+    /** Number of uncompressed bytes written so far. */
+    uint64_t tell() const { return uoffset; }
+
+    /**
+     * Converts an offset in the uncompressed stream to a BGZF virtual offset
+     * (compressed offset of the block << 16 | offset in the block). Valid after close() only.
+     */
+    uint64_t virtualOffset(uint64_t upos) const;
+
+private:
+    // uncompressed data of a task and its compressed blocks
+    struct Chunk {
+        string in;
+        string out;
+        vector<uint32_t> bsizes; // compressed size of each block
+    };
+
+    // compresses the buffer and submits it (to the pool, if present)
+    void flushBuffer();
+    // writes the oldest chunk
+    void writeFront();
+    // writes a compressed chunk and records the offsets of its blocks
+    void writeChunk(const Chunk& c);
+
+    FILE* out;
+    ThreadPool* pool;
+    shared_ptr<Chunk> buffer;
+    deque<pair<shared_ptr<Chunk>, future<void>>> inflight;
+    bool closed = false;
+    uint64_t uoffset = 0;          // uncompressed bytes written
+    uint64_t coffset = 0;          // compressed bytes written
+    vector<uint64_t> blockoffsets; // compressed offset of each block
+};
+
+/**
+ * Compresses the data to a sequence of BGZF blocks of at most BGZF_BLOCKSIZE uncompressed bytes each,
+ * which are appended to out. If bsizes is not NULL, the compressed size of each block is appended.
+ */
+void bgzfCompress(string& out, const char* data, size_t size, vector<uint32_t>* bsizes = NULL);
+
+/** The empty BGZF block marking the end of a file. */
+extern const char bgzfEOF[28];
+
+#endif /* BGZF_H_ */
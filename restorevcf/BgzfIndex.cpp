@@ -0,0 +1,247 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "BgzfIndex.h"
+#include "NumParse.h"
+
+// all values are written in little endian
+
+static inline void putLE32(string& s, uint32_t v) {
+    char b[4] = { (char) (v & 0xff), (char) ((v >> 8) & 0xff), (char) ((v >> 16) & 0xff), (char) (v >> 24) };
+    s.append(b, 4);
+}
+
+static inline void putLE64(string& s, uint64_t v) {
+    putLE32(s, (uint32_t) v);
+    putLE32(s, (uint32_t) (v >> 32));
+}
+
+static inline uint32_t getLE32(const char* p) {
+    const unsigned char* u = (const unsigned char*) p;
+    return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t) u[3] << 24);
+}
+
+// first bin on the given level
+static inline uint32_t binFirst(int level) {
+    return ((1u << (3*level)) - 1) / 7;
+}
+
+// smallest bin containing the 0-based region [beg,end) (as in the SAM specification)
+static uint32_t reg2bin(int64_t beg, int64_t end, int minshift, int depth) {
+    end--;
+    int s = minshift;
+    for (int l = depth; l > 0; l--, s += 3)
+        if (beg >> s == end >> s)
+            return binFirst(l) + (beg >> s);
+    return 0;
+}
+
+// level of a bin
+static inline int binLevel(uint32_t bin) {
+    int l = 0;
+    for (; bin; bin = (bin - 1) >> 3)
+        l++;
+    return l;
+}
+
+BgzfIndex::BgzfIndex(Format format_, bool bcf_, const string& chrom_, int32_t tid_) :
+    format(format_),
+    bcf(bcf_),
+    chrom(chrom_),
+    tid(tid_),
+    depth(format_ == TBI ? 5 : 6) // TBI: positions up to 2^29, CSI: up to 2^32
+{}
+
+void BgzfIndex::add(int64_t beg, int64_t end, uint64_t ustart, uint64_t uend) {
+    if (end <= beg)
+        end = beg + 1;
+    if (end > (1ll << (minshift + 3*depth))) {
+        cerr << "ERROR: Position " << end << " exceeds the maximum position of the index format. Use --csi." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // chunks of consecutive records in the same bin are merged
+    vector<pair<uint64_t,uint64_t>>& chunks = bins[reg2bin(beg, end, minshift, depth)];
+    if (!chunks.empty() && chunks.back().second == ustart)
+        chunks.back().second = uend;
+    else
+        chunks.emplace_back(ustart, uend);
+
+    // the records are written in order, so the first record overlapping a window has the smallest offset
+    size_t wbeg = beg >> minshift;
+    size_t wend = (end - 1) >> minshift;
+    if (linear.size() <= wend)
+        linear.resize(wend + 1, UINT64_MAX);
+    for (size_t w = wbeg; w <= wend; w++)
+        if (linear[w] == UINT64_MAX)
+            linear[w] = ustart;
+
+    if (nrecords == 0)
+        firstoffset = ustart;
+    lastoffset = uend;
+    nrecords++;
+}
+
+void BgzfIndex::scan(const char* data, size_t size, uint64_t ustart) {
+    const char* end = data + size;
+    const char* rec = data;
+    while (rec < end) {
+        if (bcf) {
+            // l_shared, l_indiv, CHROM, POS (0-based), rlen
+            if (end - rec < 20)
+                break;
+            const char* next = rec + 8 + getLE32(rec) + getLE32(rec + 4);
+            int64_t pos = (int32_t) getLE32(rec + 12);
+            int64_t rlen = (int32_t) getLE32(rec + 16);
+            add(pos, pos + rlen, ustart + (rec - data), ustart + (next - data));
+            rec = next;
+        } else {
+            const char* nl = (const char*) memchr(rec, '\n', end - rec);
+            const char* next = nl ? nl + 1 : end;
+            if (*rec != '#') {
+                // find the beginnings of POS (1), REF (3) and INFO (7)
+                const char* cols[8] = { rec };
+                const char* p = rec;
+                for (int c = 1; c < 8 && p; c++) {
+                    p = (const char*) memchr(p, '\t', next - p);
+                    if (p)
+                        cols[c] = ++p;
+                }
+                int32_t pos;
+                if (!cols[3] || !parseInt(cols[1], cols[2] - 1, pos)) {
+                    cerr << "ERROR: Cannot index malformed VCF line: " << string(rec, min((size_t) 50, (size_t) (next - rec))) << endl;
+                    exit(EXIT_FAILURE);
+                }
+                const char* refend = (const char*) memchr(cols[3], '\t', next - cols[3]);
+                int64_t e = (int64_t) pos - 1 + (refend ? refend - cols[3] : 1);
+                // an END field in INFO overrides the length of REF
+                if (cols[7]) {
+                    const char* infoend = cols[7];
+                    while (infoend < next && *infoend != '\t' && *infoend != '\n')
+                        infoend++;
+                    for (const char* f = cols[7]; f < infoend;) {
+                        const char* fend = (const char*) memchr(f, ';', infoend - f);
+                        if (!fend)
+                            fend = infoend;
+                        int32_t v;
+                        if (fend - f > 4 && memcmp(f, "END=", 4) == 0 && parseInt(f + 4, fend, v))
+                            e = v;
+                        f = fend + 1;
+                    }
+                }
+                add(pos - 1, e, ustart + (rec - data), ustart + (next - data));
+            }
+            rec = next;
+        }
+    }
+}
+
+void BgzfIndex::write(const string& filename, const BgzfWriter& bgzf) const {
+    string idx;
+
+    // tabix configuration: VCF format, CHROM in column 1, POS in column 2, no end column, meta char '#', no skipped lines
+    string conf;
+    if (!bcf) {
+        putLE32(conf, 2);
+        putLE32(conf, 1);
+        putLE32(conf, 2);
+        putLE32(conf, 0);
+        putLE32(conf, '#');
+        putLE32(conf, 0);
+        putLE32(conf, chrom.size() + 1);
+        conf.append(chrom.c_str(), chrom.size() + 1);
+    }
+
+    int32_t nref = 1;
+    if (format == TBI) {
+        idx.append("TBI\1", 4);
+        putLE32(idx, nref);
+        idx.append(conf);
+    } else {
+        idx.append("CSI\1", 4);
+        putLE32(idx, minshift);
+        putLE32(idx, depth);
+        putLE32(idx, conf.size());
+        idx.append(conf);
+        if (bcf) // the reference IDs are the contig IDs of the BCF header
+            nref = tid + 1;
+        putLE32(idx, nref);
+        for (int32_t r = 0; r < nref - 1; r++) // empty references
+            putLE32(idx, 0);
+    }
+
+    // linear index with the gaps filled by the previous offsets
+    vector<uint64_t> lin(linear.size());
+    uint64_t prev = bgzf.virtualOffset(firstoffset);
+    for (size_t w = 0; w < linear.size(); w++) {
+        if (linear[w] != UINT64_MAX)
+            prev = bgzf.virtualOffset(linear[w]);
+        lin[w] = prev;
+    }
+
+    // bins and the pseudo-bin with the offsets of all records and the number of records
+    putLE32(idx, nrecords ? bins.size() + 1 : 0);
+    for (const auto& b : bins) {
+        putLE32(idx, b.first);
+        if (format == CSI) { // offset of the first record overlapping the beginning of the bin
+            int l = binLevel(b.first);
+            size_t w = (size_t) (b.first - binFirst(l)) << (3 * (depth - l));
+            putLE64(idx, w < lin.size() ? lin[w] : 0);
+        }
+        putLE32(idx, b.second.size());
+        for (const auto& c : b.second) {
+            putLE64(idx, bgzf.virtualOffset(c.first));
+            putLE64(idx, bgzf.virtualOffset(c.second));
+        }
+    }
+    if (nrecords) {
+        putLE32(idx, binFirst(depth + 1) + 1);
+        if (format == CSI)
+            putLE64(idx, 0);
+        putLE32(idx, 2);
+        putLE64(idx, bgzf.virtualOffset(firstoffset));
+        putLE64(idx, bgzf.virtualOffset(lastoffset));
+        putLE64(idx, nrecords);
+        putLE64(idx, 0);
+    }
+
+    if (format == TBI) {
+        putLE32(idx, lin.size());
+        for (uint64_t o : lin)
+            putLE64(idx, o);
+    }
+
+    putLE64(idx, 0); // no records without coordinates
+
+    FILE* f = fopen(filename.c_str(), "w");
+    if (f == NULL) {
+        cerr << "ERROR: Unable to open index file " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    string out;
+    bgzfCompress(out, idx.data(), idx.size());
+    fwrite(out.data(), 1, out.size(), f);
+    fwrite(bgzfEOF, 1, sizeof(bgzfEOF), f);
+    fclose(f);
+}
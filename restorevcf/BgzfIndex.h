@@ -0,0 +1,85 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGZFINDEX_H_
+#define BGZFINDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Bgzf.h"
+
+using namespace std;
+
+/**
+ * Coordinate index of a BGZF compressed VCF (tabix .tbi or .csi) or BCF file (.csi),
+ * built while the file is written. The records are registered with their offsets in the
+ * uncompressed stream, which are converted to virtual offsets when the index is written
+ * after the compressed file is complete. As the output of restorevcf covers a single
+ * chromosome, the index contains only one reference sequence.
+ */
+class BgzfIndex {
+public:
+
+    enum Format { TBI, CSI };
+
+    /**
+     * @param format TBI (VCF only) or CSI
+     * @param bcf set, if the indexed file is BCF, the records are binary encoded then
+     * @param chrom name of the chromosome (VCF)
+     * @param tid ID of the chromosome in the contig dictionary of the BCF header (BCF)
+     */
+    BgzfIndex(Format format, bool bcf, const string& chrom, int32_t tid = 0);
+
+    /**
+     * Registers all records in data, which is written to the uncompressed stream at offset ustart.
+     * data has to contain complete records (lines for VCF, header lines are skipped).
+     * The BCF header must not be passed here.
+     */
+    void scan(const char* data, size_t size, uint64_t ustart);
+
+    /**
+     * Writes the index file (BGZF compressed).
+     * @param bgzf the closed writer of the indexed file for the conversion to virtual offsets
+     */
+    void write(const string& filename, const BgzfWriter& bgzf) const;
+
+private:
+    // registers a record covering [beg,end) (0-based) at [ustart,uend) in the uncompressed stream
+    void add(int64_t beg, int64_t end, uint64_t ustart, uint64_t uend);
+
+    Format format;
+    bool bcf;
+    string chrom;
+    int32_t tid;
+    int minshift = 14; // size of the smallest bins and the linear index windows (16 kb)
+    int depth;
+
+    map<uint32_t, vector<pair<uint64_t,uint64_t>>> bins; // chunks of each bin (uncompressed offsets)
+    vector<uint64_t> linear; // smallest offset of a record overlapping each window
+    size_t nrecords = 0;
+    uint64_t firstoffset = 0;
+    uint64_t lastoffset = 0;
+};
+
+#endif /* BGZFINDEX_H_ */
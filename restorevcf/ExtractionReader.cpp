@@ -0,0 +1,204 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "ExtractionReader.h"
+
+ExtractionReader::ExtractionReader(const string& filename, bool gq_, const string& sidecar_) :
+    reader(filename),
+    gq(gq_),
+    sidecarname(sidecar_)
+{}
+
+ExtractionReader::~ExtractionReader() {
+    if (sidecar && gzclose(sidecar) != Z_OK)
+        cerr << "ERROR: Failed writing " << sidecarname << "." << endl;
+}
+
+// copies s into the line buffer (reallocated if necessary, as with getline())
+static ssize_t setLine(char** line, size_t* len, const string& s) {
+    if (*line == NULL || *len < s.size() + 1) {
+        size_t newlen = max(s.size() + 1, 2 * *len);
+        char* l = (char*) realloc(*line, newlen);
+        if (l == NULL) {
+            cerr << "ERROR: Unable to allocate line buffer of " << newlen << " bytes." << endl;
+            exit(EXIT_FAILURE);
+        }
+        *line = l;
+        *len = newlen;
+    }
+    memcpy(*line, s.data(), s.size());
+    (*line)[s.size()] = '\0';
+    return s.size();
+}
+
+void ExtractionReader::readVCFHeader(char** line, size_t* len, ssize_t n) {
+    // the header lines, descriptions of FORMAT fields that are not extracted (all except GT and GQ if requested) are skipped
+    vector<string> hdr;
+    for (; n != -1 && **line == '#'; n = reader.getline(line, len)) {
+        if (strncmp(*line, "##FORMAT=<ID=", 13) == 0) {
+            const char* id = *line + 13;
+            bool keep = strncmp(id, "GT", 2) == 0 || (gq && strncmp(id, "GQ", 2) == 0);
+            if (!keep || (id[2] != ',' && id[2] != '>'))
+                continue;
+        }
+        hdr.push_back(string(*line, n));
+    }
+    if (n == -1) // no data (empty or header only) -> empty extraction
+        return;
+
+    // first line: the chromosome of the first variant and the args
+    const char* chromend = strchr(*line, '\t');
+    string first(*line, chromend ? chromend - *line : 0);
+    if (gq)
+        first.append(";--gq");
+    first.push_back('\n');
+    queued.push_back(first);
+    for (string& h : hdr) {
+        if (h.empty() || h.back() != '\n')
+            h.push_back('\n');
+        queued.push_back(h);
+    }
+
+    // the first data line
+    n = extractLine(*line, n);
+    if (n)
+        queued.push_back(string(*line, n));
+}
+
+size_t ExtractionReader::extractLine(char* line, size_t n) {
+    char* end = line + n;
+    if (n && end[-1] == '\n')
+        end--;
+    *end = '\0';
+
+    // skip CHROM, the fields from POS to INFO are moved to the beginning of the line
+    char* pos = strchr(line, '\t');
+    if (pos == NULL || *line == '#') // invalid line or embedded header of a concatenated file
+        return 0;
+    pos++;
+    char* infoend = pos;
+    for (int t = 0; t < 7 && infoend; t++) // tab after INFO
+        infoend = strchr(infoend + 1, '\t');
+    if (infoend == NULL) // no FORMAT and samples
+        infoend = end;
+    memmove(line, pos, infoend - pos);
+    char* w = line + (infoend - pos);
+
+    if (infoend != end) {
+        // position of GQ in the FORMAT field (-1 if not required or not contained)
+        char* fmt = infoend + 1;
+        char* fmtend = strchr(fmt, '\t');
+        if (fmtend == NULL)
+            fmtend = end;
+        int gqidx = -1;
+        if (gq) {
+            int idx = 0;
+            for (char* f = fmt; f < fmtend; idx++) {
+                char* fe = (char*) memchr(f, ':', fmtend - f);
+                if (fe == NULL)
+                    fe = fmtend;
+                if (fe - f == 2 && f[0] == 'G' && f[1] == 'Q') {
+                    gqidx = idx;
+                    break;
+                }
+                f = fe + 1;
+            }
+        }
+
+        // samples: GT (the first field) and GQ, the result is never longer than the original
+        char* r = fmtend;
+        while (r < end) { // r points to the tab in front of the sample
+            r++;
+            *w++ = '\t';
+            for (; *r != ':' && *r != '\t' && *r != '\0'; r++)
+                *w++ = *r;
+            if (gqidx > 0) { // GQ is omitted, if the sample does not contain it
+                for (int idx = 0; *r == ':'; ) {
+                    char* f = ++r;
+                    while (*r != ':' && *r != '\t' && *r != '\0')
+                        r++;
+                    if (++idx == gqidx) {
+                        *w++ = ':';
+                        for (; f < r; f++)
+                            *w++ = *f;
+                        break;
+                    }
+                }
+            }
+            if (*r != '\t') { // skip the remaining fields
+                r = (char*) memchr(r, '\t', end - r);
+                if (r == NULL)
+                    r = end;
+            }
+        }
+    }
+    *w++ = '\n';
+    *w = '\0';
+    return w - line;
+}
+
+void ExtractionReader::writeSidecar(const char* line, size_t n) {
+    if (sidecar && n && gzwrite(sidecar, line, n) != (int) n) {
+        cerr << "ERROR: Failed writing " << sidecarname << "." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+ssize_t ExtractionReader::getline(char** line, size_t* len) {
+    ssize_t n;
+    if (!started) { // the first line decides about the input type
+        started = true;
+        n = reader.getline(line, len);
+        if (n <= 0 || **line != '#') // extraction (or empty)
+            return n;
+        vcf = true;
+        if (!sidecarname.empty()) {
+            size_t l = sidecarname.size();
+            bool compress = l > 3 && sidecarname.compare(l - 3, 3, ".gz") == 0;
+            sidecar = gzopen(sidecarname.c_str(), compress ? "wb6" : "wT");
+            if (sidecar == NULL) {
+                cerr << "ERROR: Unable to open file " << sidecarname << " for writing." << endl;
+                exit(EXIT_FAILURE);
+            }
+            gzbuffer(sidecar, 1048576);
+        }
+        readVCFHeader(line, len, n);
+    }
+    if (!vcf)
+        return reader.getline(line, len);
+
+    if (!queued.empty()) {
+        n = setLine(line, len, queued.front());
+        queued.pop_front();
+    } else {
+        do {
+            n = reader.getline(line, len);
+            if (n == -1)
+                return -1;
+            n = extractLine(*line, n);
+        } while (n == 0); // skip invalid lines
+    }
+    writeSidecar(*line, n);
+    return n;
+}
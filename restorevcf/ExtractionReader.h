@@ -0,0 +1,88 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXTRACTIONREADER_H_
+#define EXTRACTIONREADER_H_
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <zlib.h>
+
+#include "LineReader.h"
+
+using namespace std;
+
+/**
+ * Reads the lines of an extraction from a file (or stdin), with the semantics of getline().
+ * If the file is an original VCF (plain or gzip compressed) instead of an extraction, the extraction
+ * is created in-process in the same way as vcffilter does: the first line contains the chromosome
+ * (and ";--gq" if GQ is extracted), followed by the VCF header and the data lines from POS to INFO
+ * and the GT (and GQ) field of each sample. The data lines are converted in place,
+ * so the text round trip through vcffilter is skipped.
+ * A VCF is recognized by its first line starting with '#', which is never the case for an extraction.
+ */
+class ExtractionReader {
+public:
+    /**
+     * Opens the file. Exits with an error if it cannot be opened.
+     * @param filename the file, "-" for stdin
+     * @param gq extract the GQ field in addition to GT (VCF input only)
+     * @param sidecar if not empty, the extraction created from a VCF is written to this file as well (gzip compressed if ending with .gz)
+     */
+    ExtractionReader(const string& filename, bool gq, const string& sidecar = "");
+    ~ExtractionReader();
+
+    ExtractionReader(const ExtractionReader&) = delete;
+    ExtractionReader& operator=(const ExtractionReader&) = delete;
+
+    /**
+     * Reads the next line of the extraction (including the newline character) into the buffer *line of size *len,
+     * which is reallocated if necessary (as with getline()). The line is null terminated.
+     * @return length of the line, or -1 at the end of the file
+     */
+    ssize_t getline(char** line, size_t* len);
+
+    /** Returns true if the input is an original VCF (known after the first line was read). */
+    bool isVCF() const { return vcf; }
+
+private:
+    // reads the VCF header (starting with the already read line of length n) and queues the first lines of the extraction
+    void readVCFHeader(char** line, size_t* len, ssize_t n);
+
+    // converts a VCF data line to a line of the extraction in place and returns the new length (0 for invalid lines)
+    size_t extractLine(char* line, size_t n);
+
+    // writes a line of the extraction to the sidecar file, if present
+    void writeSidecar(const char* line, size_t n);
+
+    LineReader reader;
+    bool gq;
+    string sidecarname;
+    gzFile sidecar = NULL;
+    bool started = false;
+    bool vcf = false;
+    deque<string> queued; // lines of the extraction that are returned before reading further lines
+};
+
+#endif /* EXTRACTIONREADER_H_ */
@@ -0,0 +1,108 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "GTRecode.h"
+
+// fills the 256 entry translation table for the given allele
+static void initTable(char* table, size_t allele) {
+    for (int c = 0; c < 256; c++)
+        table[c] = (char) c;
+    for (int c = '0'; c <= '9'; c++)
+        table[c] = '0';
+    table['0' + allele] = '1';
+}
+
+void recodeGT(char* dst, const char* src, size_t size, size_t allele) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // 16 chars at once: digits are replaced by '0' | (char == allele), everything else is kept
+    const __m128i lo = _mm_set1_epi8('0'-1);
+    const __m128i hi = _mm_set1_epi8('9'+1);
+    const __m128i al = _mm_set1_epi8((char)('0' + allele));
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i isdigit = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        __m128i rep = _mm_or_si128(zero, _mm_and_si128(_mm_cmpeq_epi8(v, al), one));
+        __m128i res = _mm_or_si128(_mm_and_si128(isdigit, rep), _mm_andnot_si128(isdigit, v));
+        _mm_storeu_si128((__m128i*)(dst + i), res);
+    }
+#endif
+
+    // remainder (or everything, if no SIMD is available)
+    if (i < size) {
+        char table[256];
+        initTable(table, allele);
+        for (; i < size; i++)
+            dst[i] = table[(unsigned char) src[i]];
+    }
+}
+
+size_t recodeGTMulti(char* dst, const char* src, size_t size, size_t allele, bool gq) {
+    char* w = dst;
+    const char* end = src + size;
+    bool gtfield = true;
+    while (src < end) {
+        char c = *src;
+        if (gtfield && c >= '0' && c <= '9') { // allele index
+            size_t idx = 0;
+            for (; src < end && *src >= '0' && *src <= '9'; src++)
+                idx = idx * 10 + (*src - '0');
+            *w++ = idx == allele ? '1' : '0';
+            continue;
+        }
+        if (c != '\0') { // skip deleted chars
+            if (c == ':' && gq)
+                gtfield = false;
+            else if (c == '\t')
+                gtfield = true;
+            *w++ = c;
+        }
+        src++;
+    }
+    *w = '\0';
+    return w - dst;
+}
+
+void recodeGTFields(char* dst, const char* src, size_t size, size_t allele) {
+    char table[256];
+    initTable(table, allele);
+    const char* end = src + size;
+    while (src < end) {
+        // GT field: translate until ':' (or tab for samples without further fields)
+        for (; src < end && *src != ':' && *src != '\t'; src++, dst++)
+            *dst = table[(unsigned char) *src];
+        // copy the remaining fields of this sample unchanged (including the tab)
+        const char* tab = (const char*) memchr(src, '\t', end - src);
+        const char* next = tab ? tab + 1 : end;
+        if (dst != src)
+            memmove(dst, src, next - src);
+        dst += next - src;
+        src = next;
+    }
+}
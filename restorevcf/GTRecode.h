@@ -0,0 +1,52 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTRECODE_H_
+#define GTRECODE_H_
+
+#include <cstddef>
+
+/**
+ * Recodes a block of genotypes for one allele of a multi-allelic split:
+ * each digit equal to the given allele index becomes '1', all other digits become '0'.
+ * All other characters (separators, missing '.', tabs, newline and null characters) are copied unchanged.
+ * Only valid for single digit allele indices, i.e. alleles 1 to 9.
+ * The block must contain nothing but GT fields. dst and src may be equal (in-place).
+ */
+void recodeGT(char* dst, const char* src, size_t size, size_t allele);
+
+/**
+ * Same as recodeGT(), but for blocks containing further fields after the GT field
+ * (separated by ':', e.g. GQ). Only the GT fields are recoded, the rest is copied unchanged.
+ */
+void recodeGTFields(char* dst, const char* src, size_t size, size_t allele);
+
+/**
+ * Recodes the genotypes for one allele of a multi-allelic split with allele indices of any size:
+ * each allele index equal to the given allele becomes '1', all others become '0'.
+ * Characters deleted before (set to '\0') are skipped, so the result is compacted and null terminated.
+ * If gq is set, only the GT fields are recoded, the fields after ':' are copied unchanged.
+ * dst may be equal to src (in-place).
+ * @param size number of chars in src (excluding the final null terminator)
+ * @return length of the result (excluding the null terminator)
+ */
+size_t recodeGTMulti(char* dst, const char* src, size_t size, size_t allele, bool gq);
+
+#endif /* GTRECODE_H_ */
@@ -0,0 +1,363 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "GTScan.h"
+
+// marks a missing first haplotype when converting to haploid
+#define HAPMISSING ((size_t)-1)
+
+static inline bool isdig(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// counts a single haplotype char (digit or '.')
+static inline void countHap(GTScan& s, char c) {
+    s.nhap++;
+    if (c == '.') {
+        s.ngtmiss++;
+    } else {
+        s.an++;
+        if (c != '0')
+            s.ac[c-'1']++;
+    }
+}
+
+// number of samples between two checks for an early abort
+#define ABORT_CHECK_INTERVAL 128
+
+// Checks, if the line cannot pass the missingness or MAC/MAF filters anymore, regardless of the remaining genotypes.
+// Only valid at sample boundaries. gt points to the beginning of the remaining genotypes.
+static bool failsEarly(const GTScan& s, const char* gt) {
+    // upper bound for the remaining haplotypes: each needs at least one char plus a separator
+    size_t rem = (s.gtend - gt + 1) / 2;
+
+    // missingness: final rate >= ngtmiss / (nhap + rem)
+    if (s.missfilter > 0 && s.ngtmiss / (float) (s.nhap + rem) >= s.missfilter)
+        return true;
+
+    // MAC/MAF: the allele count of each alt allele can increase by at most rem,
+    // so the line fails if no alt allele could reach the threshold anymore
+    // (for the MAF filter, (ac+rem)/(an+rem) is an upper bound for the final AF, we keep a margin of one allele)
+    if (s.macfilter || s.maffilter > 0) {
+        for (size_t n = 0; n < s.nalt; n++) {
+            double acmax = s.ac[n] + rem;
+            if (s.macfilter ? acmax >= s.macfilter : acmax + 1 >= s.maffilter * (double) (s.an + rem))
+                return false; // this allele might still pass
+        }
+        return true;
+    }
+    return false;
+}
+
+// Counting only (no per-sample actions).
+// Fast path for the dominant diploid layout with single digit alleles ("a|b" or "a/b"),
+// all other layouts are parsed char by char.
+template<bool GQ>
+static void countKernel(GTScan& s) {
+    bool earlyabort = s.gtend && (s.missfilter > 0 || s.macfilter || s.maffilter > 0);
+    size_t ncheck = ABORT_CHECK_INTERVAL;
+    char* gt = s.gtstart;
+    while (*gt != '\0') {
+        // fast path: diploid, single digits or missing
+        if ((isdig(gt[0]) || gt[0] == '.') && (gt[1] == '|' || gt[1] == '/') && (isdig(gt[2]) || gt[2] == '.')
+                && (gt[3] == '\t' || gt[3] == '\n' || gt[3] == '\0' || (GQ && gt[3] == ':'))) {
+            countHap(s, gt[0]);
+            countHap(s, gt[2]);
+            gt += 3;
+        } else { // generic: haploid, multi-digit alleles, polyploid...
+            for (; *gt != '\0' && *gt != '\t' && *gt != '\n' && (!GQ || *gt != ':'); gt++) {
+                if (*gt == '.') {
+                    s.nhap++;
+                    s.ngtmiss++;
+                } else if (isdig(*gt)) {
+                    s.nhap++;
+                    s.an++;
+                    size_t idx = *gt - '0';
+                    while (isdig(*(gt+1))) { // continue digit by digit
+                        gt++;
+                        idx = idx * 10 + (*gt - '0');
+                    }
+                    if (idx)
+                        s.ac[idx-1]++;
+                }
+            }
+        }
+        // gt points to the end of the GT field now: skip further fields and the tab
+        if (GQ && *gt == ':') {
+            gt = strchr(gt, '\t');
+            if (gt == NULL)
+                break;
+        }
+        if (*gt == '\t') {
+            gt++;
+            if (earlyabort && --ncheck == 0) {
+                ncheck = ABORT_CHECK_INTERVAL;
+                if (failsEarly(s, gt)) {
+                    s.aborted = true;
+                    return;
+                }
+            }
+        } else if (*gt == '\n')
+            break;
+    }
+}
+
+// Applies the per-sample actions in a single forward pass, the genotypes are compacted in place:
+// - conversion to haploid drops the second haplotype (and separator). If both haplotypes of a sample differ,
+//   it is a conflict and the remaining haplotype is set missing.
+// - dropped samples are removed completely and not counted.
+// The tab in front of each kept sample is written when the sample is reached, so dropping the first or last samples is no special case.
+// Fast path for diploid genotypes with single digit alleles, all other layouts are parsed char by char.
+// If WRITE is not set, the actions are applied to the counters only and the genotypes are left unchanged.
+template<bool GQ, bool WRITE>
+static void actionKernel(GTScan& s) {
+    const unsigned char* actions = s.actions->data();
+    const size_t nactions = s.actions->size();
+    size_t gtidx = s.gtidx0; // current genotype (sample) idx
+    char* r = s.gtstart; // read position
+    char* w = s.gtstart; // write position, never ahead of r
+    bool sep = false; // a kept sample was written before -> requires a tab
+    while (*r != '\0') {
+        unsigned char action = gtidx < nactions ? actions[gtidx] : SAMPLE_KEEP;
+        if (action == SAMPLE_DROP) { // skip the complete sample
+            while (*r != '\0' && *r != '\t' && *r != '\n')
+                r++;
+            if (*r == '\t') {
+                r++;
+                gtidx++;
+            } else if (*r == '\n') {
+                if (WRITE)
+                    *w++ = *r;
+                r++;
+            }
+            continue;
+        }
+        if (WRITE && sep && *r != '\n')
+            *w++ = '\t';
+        sep = true;
+        bool mkhap = action == SAMPLE_HAPLOID;
+
+        // fast path: diploid, single digits or missing
+        if ((isdig(r[0]) || r[0] == '.') && (r[1] == '|' || r[1] == '/') && (isdig(r[2]) || r[2] == '.')
+                && (r[3] == '\t' || r[3] == '\n' || r[3] == '\0' || (GQ && r[3] == ':'))) {
+            countHap(s, r[0]);
+            if (!mkhap) {
+                countHap(s, r[2]);
+                if (WRITE) {
+                    w[0] = r[0];
+                    w[1] = r[1];
+                    w[2] = r[2];
+                    w += 3;
+                }
+            } else {
+                char h = r[0];
+                if (h != '.' && r[2] != '.' && r[2] != h) { // conflict
+                    s.nhapconflicts++;
+                    s.an--;
+                    if (h != '0')
+                        s.ac[h-'1']--;
+                    s.ngtmiss++;
+                    h = '.';
+                }
+                if (WRITE)
+                    *w++ = h;
+            }
+            r += 3;
+
+        } else { // generic: haploid, multi-digit alleles, polyploid...
+            char* gtw = w; // beginning of the written GT field
+            size_t hap = 0; // first haplotype -> to check if conversion to haploid is ok
+            bool first = true;
+            bool conflict = false;
+            for (; *r != '\0' && *r != '\t' && *r != '\n' && (!GQ || *r != ':'); ) {
+                if (isdig(*r) || *r == '.') { // haplotype
+                    char* hapstart = r;
+                    size_t idx = HAPMISSING;
+                    if (*r == '.')
+                        r++;
+                    else {
+                        idx = 0;
+                        for (; isdig(*r); r++) // continue digit by digit
+                            idx = idx * 10 + (*r - '0');
+                    }
+                    if (first || !mkhap) {
+                        s.nhap++;
+                        if (idx == HAPMISSING)
+                            s.ngtmiss++;
+                        else {
+                            s.an++;
+                            if (idx)
+                                s.ac[idx-1]++;
+                        }
+                        if (first)
+                            hap = idx;
+                        if (WRITE) {
+                            while (hapstart < r)
+                                *w++ = *hapstart++;
+                        }
+                        first = false;
+                    } else if (!conflict && idx != HAPMISSING && hap != HAPMISSING && idx != hap) {
+                        // further haplotype differs from the first: set the remaining one missing
+                        conflict = true;
+                        s.nhapconflicts++;
+                        s.an--;
+                        if (hap)
+                            s.ac[hap-1]--;
+                        s.ngtmiss++;
+                        if (WRITE) {
+                            w = gtw;
+                            *w++ = '.';
+                        }
+                    } // else: further haplotype is dropped
+                } else if (mkhap && !first && (*r == '/' || *r == '|')) { // separator is dropped together with the haplotype
+                    r++;
+                } else {
+                    if (WRITE)
+                        *w++ = *r;
+                    r++;
+                }
+            }
+        }
+
+        // end of the GT field: copy further fields, the tab is written with the next kept sample
+        if (GQ && *r == ':') {
+            char* tab = strchr(r, '\t');
+            char* fend = tab ? tab : r + strlen(r);
+            if (WRITE) {
+                if (w != r)
+                    memmove(w, r, fend - r);
+                w += fend - r;
+            }
+            r = fend;
+        }
+        if (*r == '\t') {
+            r++;
+            gtidx++;
+        } else if (*r == '\n') {
+            if (WRITE)
+                *w++ = *r;
+            r++;
+        }
+    }
+    if (WRITE) {
+        *w = '\0';
+        s.gtlen = w - s.gtstart;
+    }
+}
+
+void scanGenotypes(GTScan& s, bool modify, bool gq) {
+    s.an = 0;
+    s.nhap = 0;
+    s.ngtmiss = 0;
+    s.nhapconflicts = 0;
+    s.aborted = false;
+
+    // dispatch table for all specializations, index: (modify ? (countonly ? 2 : 1) : 0) << 1 | gq
+    static void (*const kernels[6])(GTScan&) = {
+            countKernel<false>,
+            countKernel<true>,
+            actionKernel<false, true>,
+            actionKernel<true, true>,
+            actionKernel<false, false>,
+            actionKernel<true, false>
+    };
+    kernels[(modify ? (s.countonly ? 4 : 2) : 0) | (gq ? 1 : 0)](s);
+}
+
+void scanGenotypesParallel(GTScan& s, char* gtend, bool modify, bool gq, ThreadPool& pool) {
+    unsigned nparts = pool.size();
+    size_t len = gtend - s.gtstart;
+
+    // partition at tab boundaries: part i is [bounds[i], bounds[i+1])
+    vector<char*> bounds(nparts+1);
+    bounds[0] = s.gtstart;
+    bounds[nparts] = gtend;
+    for (unsigned i = 1; i < nparts; i++) {
+        char* b = max(s.gtstart + len * i / nparts, bounds[i-1]);
+        char* tab = (char*) memchr(b, '\t', gtend - b);
+        bounds[i] = tab ? tab+1 : gtend;
+    }
+    // terminate the parts (replace the tab at the end of each part with the null character)
+    for (unsigned i = 1; i < nparts; i++) {
+        if (bounds[i] != gtend)
+            *(bounds[i]-1) = '\0';
+    }
+
+    // local copies of the scan context, each with own counters and parts
+    vector<GTScan> parts(nparts, s);
+    vector<vector<size_t>> acs(nparts, vector<size_t>(s.nalt, 0));
+    vector<size_t> ntabs(nparts, 0);
+    for (unsigned i = 0; i < nparts; i++) {
+        parts[i].gtstart = bounds[i];
+        parts[i].ac = acs[i].data();
+        parts[i].gtend = NULL; // no early abort for parts
+    }
+
+    // sample index of the first genotype in each part is required for the per-sample actions only
+    if (modify) {
+        pool.parallelFor(nparts, [&](unsigned i) {
+            ntabs[i] = count(bounds[i], bounds[i+1], '\t') + (bounds[i+1] != gtend ? 1 : 0); // the tab at the end of the part was replaced
+        });
+        for (unsigned i = 1; i < nparts; i++)
+            parts[i].gtidx0 = parts[i-1].gtidx0 + ntabs[i-1];
+    }
+
+    pool.parallelFor(nparts, [&](unsigned i) {
+        if (bounds[i] != bounds[i+1])
+            scanGenotypes(parts[i], modify, gq);
+    });
+
+    if (modify && !s.countonly) { // join the compacted parts, restoring the tabs in between (only parts with kept samples are separated)
+        char* w = s.gtstart;
+        for (unsigned i = 0; i < nparts; i++) {
+            size_t plen = bounds[i] != bounds[i+1] ? parts[i].gtlen : 0;
+            if (plen && w != s.gtstart && *bounds[i] != '\n')
+                *w++ = '\t';
+            if (w != bounds[i])
+                memmove(w, bounds[i], plen);
+            w += plen;
+        }
+        *w = '\0';
+        s.gtlen = w - s.gtstart;
+    } else { // restore tabs
+        for (unsigned i = 1; i < nparts; i++) {
+            if (bounds[i] != gtend)
+                *(bounds[i]-1) = '\t';
+        }
+    }
+
+    // reduce
+    s.an = 0;
+    s.nhap = 0;
+    s.ngtmiss = 0;
+    s.nhapconflicts = 0;
+    s.aborted = false;
+    for (unsigned i = 0; i < nparts; i++) {
+        s.an += parts[i].an;
+        s.nhap += parts[i].nhap;
+        s.ngtmiss += parts[i].ngtmiss;
+        s.nhapconflicts += parts[i].nhapconflicts;
+        for (size_t a = 0; a < s.nalt; a++)
+            s.ac[a] += acs[i][a];
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTSCAN_H_
+#define GTSCAN_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// minimum size of a genotype block to be scanned in parallel
+#ifndef PARALLEL_SCAN_MINSIZE
+#define PARALLEL_SCAN_MINSIZE 1048576
+#endif
+
+using namespace std;
+
+/**
+ * Action for a single sample during the scan.
+ */
+enum SampleAction : unsigned char {
+    SAMPLE_KEEP = 0,    /**< keep the genotype unchanged */
+    SAMPLE_HAPLOID = 1, /**< convert the genotype to haploid */
+    SAMPLE_DROP = 2     /**< remove the sample, it is not counted either */
+};
+
+/**
+ * Input and results of the scan over the genotypes of one line.
+ */
+struct GTScan {
+    // input
+    char* gtstart = NULL;  /**< first char of the first genotype, the genotypes end with the null terminator of the line */
+    size_t gtidx0 = 0;     /**< sample index of the first genotype (if only a part of the line is scanned) */
+    size_t nalt = 0;       /**< number of alternative alleles */
+    size_t* ac = NULL;     /**< allele counters for all alt alleles, need to be initialized with 0 */
+    const vector<unsigned char>* actions = NULL; /**< action for each sample index (if modify is set), samples beyond the table are kept */
+    bool countonly = false; /**< the per-sample actions are applied to the counters only, the genotypes are left unchanged (gtlen is not set) */
+
+    // early abort: if gtend is set, the counting scan stops as soon as the line cannot pass the active filters anymore
+    char* gtend = NULL;    /**< end of the genotypes (pointing at the null terminator of the line) */
+    float missfilter = 0;
+    size_t macfilter = 0;
+    float maffilter = 0;
+
+    // results
+    size_t an = 0;            /**< allele number */
+    size_t nhap = 0;          /**< number of haplotypes including missing ones */
+    size_t ngtmiss = 0;       /**< number of missing haplotypes */
+    size_t nhapconflicts = 0; /**< number of conflicts when converting to haploid */
+    bool aborted = false;     /**< set, if the scan was aborted early, the counters are incomplete then */
+    size_t gtlen = 0;         /**< length of the genotypes after applying the per-sample actions, which compacts them in place */
+};
+
+/**
+ * Scans all genotypes of a line, counts the alleles and applies the requested modifications.
+ * Dispatches to the kernel specialized for the given set of features:
+ * @param modify apply the per-sample actions (conversion to haploid, dropping samples), the genotypes are compacted in place (see gtlen),
+ *               unless countonly is set
+ * @param gq genotypes contain a further field (GQ) after the GT field
+ */
+void scanGenotypes(GTScan& s, bool modify, bool gq);
+
+/**
+ * Same as scanGenotypes(), but partitions the genotypes at tab boundaries and scans the parts
+ * concurrently on the threads of the provided pool. The results are reduced into s,
+ * compacted parts are joined again (modify).
+ * No early abort here.
+ * @param gtend end of the genotypes (pointing at the null terminator of the line)
+ */
+void scanGenotypesParallel(GTScan& s, char* gtend, bool modify, bool gq, ThreadPool& pool);
+
+#endif /* GTSCAN_H_ */
@@ -0,0 +1,64 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "InfoIndex.h"
+
+char* findInfoField(char* info, const char* query) {
+    char* ret = NULL;
+    do {
+        ret = strstr(info, query);
+        if (ret != NULL && (ret == info || *(ret-1) == ';'))
+            return ret;
+        if (ret != NULL) // false match in the middle of another field -> continue search after this position
+            info = ret+1;
+    } while(ret != NULL);
+    return NULL;
+}
+
+void InfoIndex::parse(char* info, char* infoend) {
+    fields.clear(); // keeps the capacity, so there are no further allocations after the first lines
+    if (info == infoend) // empty INFO column
+        return;
+    Field f;
+    f.key = info;
+    f.val = NULL;
+    for (char* c = info; c != infoend; c++) {
+        if (*c == '=' && f.val == NULL) {
+            f.keylen = c - f.key;
+            f.val = c+1;
+        } else if (*c == ';') {
+            f.end = c;
+            if (f.val == NULL) { // flag
+                f.keylen = c - f.key;
+                f.val = c;
+            }
+            fields.push_back(f);
+            f.key = c+1;
+            f.val = NULL;
+        }
+    }
+    // last field
+    f.end = infoend;
+    if (f.val == NULL) {
+        f.keylen = infoend - f.key;
+        f.val = infoend;
+    }
+    fields.push_back(f);
+}
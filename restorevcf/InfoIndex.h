@@ -0,0 +1,69 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INFOINDEX_H_
+#define INFOINDEX_H_
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Index of the fields of an INFO column, created in a single pass over the column.
+ * The index only stores pointers into the (unmodified) INFO column, so it is valid
+ * as long as the line buffer is not modified.
+ */
+class InfoIndex {
+public:
+
+    struct Field {
+        char* key;      /**< beginning of the field (first char of the key) */
+        size_t keylen;  /**< length of the key (excluding '=') */
+        char* val;      /**< beginning of the value (after '='), equals end for flags */
+        char* end;      /**< end of the field (exclusive), pointing at ';' or the end of the INFO column */
+    };
+
+    /** Tokenizes the INFO column from info to infoend (exclusive). Replaces the previous index. */
+    void parse(char* info, char* infoend);
+
+    /** Returns the field with the given key or NULL if it does not exist. */
+    const Field* find(const char* key) const {
+        size_t keylen = strlen(key);
+        for (const auto& f : fields) {
+            if (f.keylen == keylen && memcmp(f.key, key, keylen) == 0)
+                return &f;
+        }
+        return NULL;
+    }
+
+    /** All fields in the order of their appearance */
+    vector<Field> fields;
+
+};
+
+/**
+ * Searches the INFO column for the first field starting with the given query (e.g. "AF=")
+ * without creating an index. Returns the beginning of the field or NULL if not found.
+ */
+char* findInfoField(char* info, const char* query);
+
+#endif /* INFOINDEX_H_ */
@@ -0,0 +1,140 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "LineReader.h"
+
+LineReader::LineReader(const string& filename_) :
+    filename(filename_),
+    buf(LINEREADER_BUFSIZE)
+{
+    fd = filename == "-" ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "ERROR: Unable to open input file " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    // the first bytes decide about the compression
+    end = readRaw(buf.data(), buf.size());
+    if (end >= 2 && buf[0] == '\x1f' && buf[1] == '\x8b') {
+        gzip = true;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) { // gzip header
+            cerr << "ERROR: Failed to initialize zlib." << endl;
+            exit(EXIT_FAILURE);
+        }
+        inbuf.assign(buf.begin(), buf.begin() + end);
+        zs.next_in = (Bytef*) inbuf.data();
+        zs.avail_in = end;
+        end = 0;
+    }
+}
+
+LineReader::~LineReader() {
+    if (gzip)
+        inflateEnd(&zs);
+    if (fd != STDIN_FILENO)
+        close(fd);
+}
+
+size_t LineReader::readRaw(char* dst, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+        ssize_t r = read(fd, dst + n, size - n);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            cerr << "ERROR: Failed reading " << filename << ": " << strerror(errno) << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (r == 0)
+            break;
+        n += r;
+    }
+    return n;
+}
+
+bool LineReader::fill() {
+    pos = 0;
+    if (!gzip) {
+        end = readRaw(buf.data(), buf.size());
+        return end > 0;
+    }
+    // inflate as much as fits into the buffer, concatenated gzip members (e.g. BGZF blocks) are decompressed one after another
+    zs.next_out = (Bytef*) buf.data();
+    zs.avail_out = buf.size();
+    while (zs.avail_out > 0) {
+        if (zs.avail_in == 0) {
+            if (zeof)
+                break;
+            size_t n = readRaw(inbuf.data(), inbuf.size());
+            if (n == 0) {
+                zeof = true;
+                break;
+            }
+            zs.next_in = (Bytef*) inbuf.data();
+            zs.avail_in = n;
+        }
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END)
+            inflateReset(&zs);
+        else if (ret != Z_OK) {
+            cerr << "ERROR: Failed decompressing " << filename << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    end = buf.size() - zs.avail_out;
+    return end > 0;
+}
+
+ssize_t LineReader::getline(char** line, size_t* len) {
+    size_t n = 0;
+    while (pos < end || fill()) {
+        const char* s = buf.data() + pos;
+        const char* nl = (const char*) memchr(s, '\n', end - pos);
+        size_t cnt = nl ? (size_t) (nl - s) + 1 : end - pos;
+        if (*line == NULL || *len < n + cnt + 1) {
+            size_t newlen = max(n + cnt + 1, 2 * *len);
+            char* l = (char*) realloc(*line, newlen);
+            if (l == NULL) {
+                cerr << "ERROR: Unable to allocate line buffer of " << newlen << " bytes." << endl;
+                exit(EXIT_FAILURE);
+            }
+            *line = l;
+            *len = newlen;
+        }
+        memcpy(*line + n, s, cnt);
+        n += cnt;
+        pos += cnt;
+        if (nl)
+            break;
+    }
+    if (n == 0)
+        return -1;
+    (*line)[n] = '\0';
+    return n;
+}
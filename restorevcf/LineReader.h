@@ -0,0 +1,77 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINEREADER_H_
+#define LINEREADER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <zlib.h>
+
+// size of the read buffer
+#define LINEREADER_BUFSIZE 4194304
+
+using namespace std;
+
+/**
+ * Reads lines from a plain or gzip compressed file (or stdin) with the semantics of getline().
+ * Compression is detected by the gzip magic number, plain files are read without any further copy.
+ */
+class LineReader {
+public:
+    /**
+     * Opens the file. Exits with an error if it cannot be opened.
+     * @param filename the file, "-" for stdin
+     */
+    LineReader(const string& filename);
+    ~LineReader();
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    /**
+     * Reads the next line (including the newline character) into the buffer *line of size *len,
+     * which is reallocated if necessary (as with getline()). The line is null terminated.
+     * @return length of the line, or -1 at the end of the file
+     */
+    ssize_t getline(char** line, size_t* len);
+
+private:
+    // refills the read buffer, returns false at the end of the file
+    bool fill();
+
+    // reads from the file into the given buffer, returns the number of bytes read (0 at the end of the file)
+    size_t readRaw(char* dst, size_t size);
+
+    string filename;
+    int fd;
+    bool gzip = false;
+    z_stream zs;
+    vector<char> inbuf;  // compressed data (gzip only)
+    bool zeof = false;   // end of the compressed input
+    vector<char> buf;    // uncompressed data
+    size_t pos = 0;
+    size_t end = 0;
+};
+
+#endif /* LINEREADER_H_ */
@@ -0,0 +1,51 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUMPARSE_H_
+#define NUMPARSE_H_
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+
+// Numeric parsing directly on the line buffer: no allocations, no locale.
+// All functions parse the complete range [begin,end) and return false if
+// the range does not contain a valid number (e.g. the missing value '.').
+
+inline bool parseFloat(const char* begin, const char* end, float& val) {
+    if (begin != end && *begin == '+') // from_chars does not accept a leading '+'
+        begin++;
+    auto res = std::from_chars(begin, end, val);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+inline bool parseInt(const char* begin, const char* end, int32_t& val) {
+    if (begin != end && *begin == '+')
+        begin++;
+    auto res = std::from_chars(begin, end, val);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+inline bool parseUInt(const char* begin, const char* end, size_t& val) {
+    auto res = std::from_chars(begin, end, val);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+#endif /* NUMPARSE_H_ */
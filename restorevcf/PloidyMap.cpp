@@ -0,0 +1,196 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+
+#include "PloidyMap.h"
+#include "NumParse.h"
+
+bool readSampleActions(const string& filename, SampleAction action, vector<unsigned char>& actions,
+        const unordered_map<string, size_t>* sampleidxs, size_t* nunknown) {
+    FILE* idxf = fopen(filename.c_str(), "r");
+    if (!idxf)
+        return false;
+    char* line = NULL;
+    size_t len = 0;
+    ssize_t nidx;
+    while((nidx = getline(&line, &len, idxf)) != -1) {
+        char* idxend = line + nidx;
+        while (idxend != line && (*(idxend-1) == '\n' || *(idxend-1) == '\r'))
+            idxend--;
+        size_t idx;
+        bool found;
+        if (sampleidxs) { // sample ID
+            if (idxend == line)
+                continue;
+            auto it = sampleidxs->find(string(line, idxend));
+            found = it != sampleidxs->end();
+            if (found)
+                idx = it->second;
+            else {
+                found = parseUInt(line, idxend, idx); // no such ID, but may be an index
+                if (!found && nunknown)
+                    (*nunknown)++;
+            }
+        } else // sample index
+            found = parseUInt(line, idxend, idx);
+        if (found) {
+            if (idx >= actions.size())
+                actions.resize(idx+1, SAMPLE_KEEP);
+            actions[idx] = action;
+        }
+    }
+    free(line);
+    fclose(idxf);
+    return true;
+}
+
+void parseSampleIDs(const string& chromline, unordered_map<string, size_t>& sampleidxs) {
+    size_t end = chromline.size();
+    if (end && chromline[end-1] == '\r')
+        end--;
+    // samples start in the 10th column
+    istringstream ls(chromline.substr(0, end));
+    string col;
+    for (size_t c = 0; getline(ls, col, '\t'); c++) {
+        if (c >= 9)
+            sampleidxs[col] = c - 9;
+    }
+}
+
+bool readSampleHeader(const string& filename, unordered_map<string, size_t>& sampleidxs) {
+    ifstream in(filename);
+    string line;
+    while (getline(in, line)) {
+        if (line.compare(0, 6, "#CHROM") != 0)
+            continue;
+        parseSampleIDs(line, sampleidxs);
+        return true;
+    }
+    return false;
+}
+
+// returns true, if the table contains at least one sample to be modified
+static bool anyModified(const vector<unsigned char>& actions) {
+    return find_if(actions.begin(), actions.end(), [](unsigned char a) { return a != SAMPLE_KEEP; }) != actions.end();
+}
+
+PloidyMap::PloidyMap(const vector<unsigned char>& defaultactions) {
+    Segment s;
+    s.start = 0;
+    s.end = (size_t) -1;
+    s.actions = defaultactions;
+    s.anymod = anyModified(defaultactions);
+    segments.push_back(s);
+}
+
+void PloidyMap::loadRegions(const string& filename, const string& chrom) {
+
+    struct Region {
+        size_t start; // inclusive
+        size_t end;   // exclusive
+        SampleAction action; // HAPLOID or KEEP for the listed samples, all others are not touched
+        vector<unsigned char> listed; // the listed samples are marked as HAPLOID here
+    };
+    vector<Region> regions;
+
+    ifstream in(filename);
+    if (!in) {
+        cerr << "ERROR: Unable to open ploidy regions file " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    string line;
+    size_t nl = 0;
+    while (getline(in, line)) {
+        nl++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream ls(line);
+        string rchrom, samplefile;
+        size_t start, end;
+        unsigned ploidy;
+        if (!(ls >> rchrom >> start >> end >> ploidy >> samplefile) || start == 0 || end < start || ploidy < 1 || ploidy > 2) {
+            cerr << "ERROR: Invalid line " << nl << " in ploidy regions file " << filename << " (expecting CHROM START END PLOIDY SAMPLEFILE with ploidy 1 or 2)" << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (rchrom != chrom)
+            continue;
+        Region r;
+        r.start = start;
+        r.end = end + 1;
+        r.action = ploidy == 1 ? SAMPLE_HAPLOID : SAMPLE_KEEP;
+        if (!readSampleActions(samplefile, SAMPLE_HAPLOID, r.listed)) {
+            cerr << "ERROR: Unable to open sample file " << samplefile << " (ploidy regions file line " << nl << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+        regions.push_back(std::move(r));
+    }
+    nregions = regions.size();
+    if (regions.empty())
+        return;
+
+    // the region boundaries divide the positions into segments
+    vector<size_t> bounds(1, 0);
+    for (const auto& r : regions) {
+        bounds.push_back(r.start);
+        bounds.push_back(r.end);
+    }
+    sort(bounds.begin(), bounds.end());
+    bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+    bounds.push_back((size_t) -1);
+
+    // resolve the action table for each segment
+    const vector<unsigned char> defaultactions = segments[0].actions;
+    segments.clear();
+    for (size_t b = 0; b + 1 < bounds.size(); b++) {
+        Segment s;
+        s.start = bounds[b];
+        s.end = bounds[b+1];
+        s.actions = defaultactions;
+        for (const auto& r : regions) {
+            if (r.start <= s.start && s.start < r.end) { // the region covers the whole segment
+                if (r.listed.size() > s.actions.size())
+                    s.actions.resize(r.listed.size(), SAMPLE_KEEP);
+                for (size_t i = 0; i < r.listed.size(); i++) {
+                    if (r.listed[i] && s.actions[i] != SAMPLE_DROP)
+                        s.actions[i] = r.action;
+                }
+            }
+        }
+        // merge with the previous segment if the tables are equal
+        if (!segments.empty() && segments.back().actions == s.actions) {
+            segments.back().end = s.end;
+        } else {
+            s.anymod = anyModified(s.actions);
+            segments.push_back(std::move(s));
+        }
+    }
+}
+
+const PloidyMap::Segment* PloidyMap::find(size_t pos) const {
+    // first segment starting after pos, the segment before contains pos
+    auto it = upper_bound(segments.begin(), segments.end(), pos, [](size_t p, const Segment& s) { return p < s.start; });
+    return &*(it-1);
+}
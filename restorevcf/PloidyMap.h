@@ -0,0 +1,97 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLOIDYMAP_H_
+#define PLOIDYMAP_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "GTScan.h"
+
+using namespace std;
+
+/**
+ * Reads a list of samples from a file, one per line, and marks the samples with the given action in the table.
+ * The table is enlarged if required. The samples are given by their indices (starting with 0), or by their IDs
+ * if sampleidxs is provided, which maps the IDs to the indices. Entries not found in sampleidxs are taken as indices,
+ * if they are numbers, otherwise they are counted in nunknown.
+ * Returns false if the file cannot be opened.
+ */
+bool readSampleActions(const string& filename, SampleAction action, vector<unsigned char>& actions,
+        const unordered_map<string, size_t>* sampleidxs = NULL, size_t* nunknown = NULL);
+
+/**
+ * Maps the sample IDs in the given #CHROM line of a VCF header to their indices (starting with 0).
+ */
+void parseSampleIDs(const string& chromline, unordered_map<string, size_t>& sampleidxs);
+
+/**
+ * Reads the sample IDs from the #CHROM line of a VCF header and maps each ID to its index (starting with 0).
+ * Returns false if the file cannot be opened or contains no #CHROM line.
+ */
+bool readSampleHeader(const string& filename, unordered_map<string, size_t>& sampleidxs);
+
+/**
+ * Maps genomic positions to the per-sample action tables (ploidy) valid at that position.
+ * The positions are divided into consecutive segments, each with a constant action table, which are
+ * resolved once when loading the regions, so switching the table requires no lookup for each line.
+ */
+class PloidyMap {
+public:
+
+    struct Segment {
+        size_t start;   /**< first position of the segment */
+        size_t end;     /**< first position after the segment */
+        vector<unsigned char> actions; /**< action for each sample index */
+        bool anymod;    /**< set, if at least one sample is modified (converted to haploid or dropped) */
+    };
+
+    /**
+     * Creates a map with a single segment covering all positions with the given default actions.
+     */
+    explicit PloidyMap(const vector<unsigned char>& defaultactions);
+
+    /**
+     * Loads the ploidy regions for the given chromosome from a file and applies them on top of the default actions.
+     * Each line contains (separated by whitespace): CHROM START END PLOIDY SAMPLEFILE
+     * with START and END as 1-based inclusive positions, PLOIDY 1 or 2 and SAMPLEFILE a file with the indices
+     * of the samples (starting with 0) with this ploidy in the region. Lines for other chromosomes are ignored,
+     * lines starting with '#' are comments. Overlapping regions are applied in the order of the file.
+     * Dropped samples remain dropped.
+     * Exits with an error message if the file is invalid.
+     */
+    void loadRegions(const string& filename, const string& chrom);
+
+    /** Returns the segment containing the given position. */
+    const Segment* find(size_t pos) const;
+
+    /** Number of segments, i.e. 1 if the actions do not depend on the position */
+    size_t size() const { return segments.size(); }
+
+    /** Number of loaded regions */
+    size_t nregions = 0;
+
+private:
+    vector<Segment> segments; // sorted by position, covering all positions
+};
+
+#endif /* PLOIDYMAP_H_ */
@@ -4,15 +4,60 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../Bcf.cpp \
+../Bgzf.cpp \
+../BgzfIndex.cpp \
+../ExtractionReader.cpp \
+../GTRecode.cpp \
+../GTScan.cpp \
+../InfoIndex.cpp \
+../LineReader.cpp \
+../PloidyMap.cpp \
 ../RestoreArgs.cpp \
+../RestoreHeader.cpp \
+../RestoreOutput.cpp \
+../Restorer.cpp \
+../SiteFilter.cpp \
+../ThreadPool.cpp \
+../VarStats.cpp \
 ../restorevcf.cpp 
 
 CPP_DEPS += \
+./Bcf.d \
+./Bgzf.d \
+./BgzfIndex.d \
+./ExtractionReader.d \
+./GTRecode.d \
+./GTScan.d \
+./InfoIndex.d \
+./LineReader.d \
+./PloidyMap.d \
 ./RestoreArgs.d \
+./RestoreHeader.d \
+./RestoreOutput.d \
+./Restorer.d \
+./SiteFilter.d \
+./ThreadPool.d \
+./VarStats.d \
 ./restorevcf.d 
 
 OBJS += \
+./Bcf.o \
+./Bgzf.o \
+./BgzfIndex.o \
+./ExtractionReader.o \
+./GTRecode.o \
+./GTScan.o \
+./InfoIndex.o \
+./LineReader.o \
+./PloidyMap.o \
 ./RestoreArgs.o \
+./RestoreHeader.o \
+./RestoreOutput.o \
+./Restorer.o \
+./SiteFilter.o \
+./ThreadPool.o \
+./VarStats.o \
 ./restorevcf.o 
 
 
@@ -20,7 +65,7 @@ OBJS += \
 %.o: ../%.cpp subdir.mk
 	@echo 'Building file: $<'
 	@echo 'Invoking: GCC C++ Compiler'
-	g++ -O3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	g++ -O3 -Wall -pthread -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
@@ -28,7 +73,7 @@ OBJS += \
 clean: clean--2e-
 
 clean--2e-:
-	-$(RM) ./RestoreArgs.d ./RestoreArgs.o ./restorevcf.d ./restorevcf.o
+	-$(RM) ./Bcf.d ./Bcf.o ./Bgzf.d ./Bgzf.o ./BgzfIndex.d ./BgzfIndex.o ./ExtractionReader.d ./ExtractionReader.o ./GTRecode.d ./GTRecode.o ./GTScan.d ./GTScan.o ./InfoIndex.d ./InfoIndex.o ./LineReader.d ./LineReader.o ./PloidyMap.d ./PloidyMap.o ./RestoreArgs.d ./RestoreArgs.o ./RestoreHeader.d ./RestoreHeader.o ./RestoreOutput.d ./RestoreOutput.o ./Restorer.d ./Restorer.o ./SiteFilter.d ./SiteFilter.o ./ThreadPool.d ./ThreadPool.o ./VarStats.d ./VarStats.o ./restorevcf.d ./restorevcf.o
 
 .PHONY: clean--2e-
 
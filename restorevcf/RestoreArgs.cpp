@@ -21,6 +21,8 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <sstream>
+#include <set>
 
 #include <boost/program_options.hpp>
 
@@ -66,6 +68,68 @@ using namespace bpo;
         exit(EXIT_FAILURE);
     }
 
+    // samples can either be excluded or included
+    if (!args.excludefile.empty() && !args.includefile.empty()) {
+        cerr << "ERROR: --exclude-samples and --include-samples cannot be used together." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // sites can either be excluded or included
+    if (!args.excludesites.empty() && !args.includesites.empty()) {
+        cerr << "ERROR: --exclude-sites and --include-sites cannot be used together." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // the extraction can only be written for a single input
+    if (!args.extractionout.empty() && args.inputs.size() > 1) {
+        cerr << "ERROR: --write-extraction requires a single input." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // output type
+    if (args.outputtype != "v" && args.outputtype != "z" && args.outputtype != "b") {
+        cerr << "ERROR: Unknown output type \"" << args.outputtype << "\". Expecting v, z or b." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // outputs
+    if (args.profilestrs.empty())
+        args.profiles.push_back(args.toProfile("", args.outfile));
+    else if (!args.vars["output"].defaulted()) {
+        cerr << "ERROR: --output cannot be used with profiles, the output files are given by the profiles." << endl;
+        exit(EXIT_FAILURE);
+    }
+    for (const string& p : args.profilestrs)
+        args.profiles.push_back(parseProfile(p));
+
+    // the output type is derived from the file name, if not given explicitly (not for the prefixes of shards)
+    bool sharding = args.shardvariants || args.shardbytes;
+    auto endsWith = [](const string& s, const string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    set<string> outfiles;
+    for (auto& p : args.profiles) {
+        // each output file (or shard prefix) can only be written by one profile, this includes stdout ("-")
+        if (!outfiles.insert(p.outfile).second) {
+            cerr << "ERROR: " << (sharding ? "Shard prefix " : "Output file ") << p.outfile << " is used by more than one profile." << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!args.vars["output-type"].defaulted() || sharding)
+            p.outputtype = args.outputtype[0];
+        else if (endsWith(p.outfile, ".bcf"))
+            p.outputtype = 'b';
+        else if (endsWith(p.outfile, ".gz") || endsWith(p.outfile, ".bgz"))
+            p.outputtype = 'z';
+        if (p.outputtype == 'b' && args.noheader) {
+            cerr << "ERROR: BCF output requires the header, --noheader cannot be used with BCF output." << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (sharding && p.outfile == "-") {
+            cerr << "ERROR: Sharding requires an output prefix (-o or the output file of the profile), cannot write shards to stdout." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     return args;
 }
 
@@ -140,7 +204,28 @@ RestoreArgs::RestoreArgs(int argc, char *argv[]) :
     ("missfilter", value<float>(&missfilter)->default_value(0.0), "only variants with a genotype missingness rate < value are returned")
     ("filterunknown", "removes unknown alleles (named \"*\")")
     ("splitma", "splits multi-allelic variants into several bi-allelic ones, filling up with the reference '0'. Note, that this implies --rminfo.")
+    ("stats", "adds extended statistics to the INFO column: F_MISSING (fraction of missing genotypes) and HWE (Hardy-Weinberg exact test p-value of the diploid genotypes for each alt allele)")
+    ("hwefilter", value<float>(&hwefilter)->default_value(0.0), "only variants with a Hardy-Weinberg exact test p-value >= value for all alt alleles are returned (for each allele with --splitma)")
+    ("sites-only", "writes only the site columns (up to INFO) with the recalculated values, without FORMAT and genotypes. The genotypes are only counted, not rewritten.")
     ("makehap", value<string>(&hapidxfile), "file with indices of sample columns (starting with 0) which should be made haploid during restoring")
+    ("ploidy-regions", value<string>(&ploidyfile), "file with regions of a specific ploidy for a set of samples, one per line: CHROM START END PLOIDY SAMPLEFILE (1-based, inclusive positions, ploidy 1 or 2, sample file with indices as for --makehap). Samples with ploidy 1 are made haploid in the region, overriding --makehap.")
+    ("exclude-samples", value<string>(&excludefile), "file with samples to be removed, one per line. Samples are given by their IDs as in the VCF header of the extraction (or --sample-header) or by their column indices (starting with 0). AC/AN/AF and all filters are computed on the remaining samples.")
+    ("include-samples", value<string>(&includefile), "file with samples to be kept, one per line, all others are removed (see --exclude-samples).")
+    ("sample-header", value<string>(&sampleheader), "VCF header (at least the #CHROM line) with the sample IDs of the extraction, to select samples by ID if the extraction does not contain the VCF header.")
+    ("include-sites", value<string>(&includesites), "file with variants to be restored, one per line, given by their IDs or as CHR:POS:REF:ALT. All other variants are skipped.")
+    ("exclude-sites", value<string>(&excludesites), "file with variants to be skipped, one per line, given by their IDs or as CHR:POS:REF:ALT.")
+    ("groups", value<string>(&groupsfile), "file with sample groups (e.g. populations), one sample per line: SAMPLE GROUP. Samples are given by their IDs or column indices (see --exclude-samples). Adds the allele counts AC_GROUP and allele numbers AN_GROUP of each group to the INFO column.")
+    ("noheader", "does not print the VCF header, even if it is contained in the extraction")
+    ("output,o", value<string>(&outfile)->default_value("-"), "output file, \"-\" is stdout")
+    ("output-type,O", value<string>(&outputtype)->default_value("v"), "output type: v (uncompressed VCF), z (BGZF compressed VCF) or b (BGZF compressed BCF, requires the VCF header in the extraction). If not given, files ending with .gz or .bgz are written as z and files ending with .bcf as b. Compression runs on the worker threads, if --threads is used. Compressed output files are indexed (.tbi for VCF, .csi for BCF) while they are written.")
+    ("shard-variants", value<size_t>(&shardvariants)->default_value(0), "splits the output into shards of at most this number of variants. The output file (-o, or the output file of a profile) is used as prefix of the shards, which are named PREFIX.NNNN.vcf (.vcf.gz with -O z, .bcf with -O b). Each shard contains the header and is indexed, if compressed. The shards are listed in PREFIX.manifest.tsv with their first and last position and their number of variants as soon as they are complete.")
+    ("shard-bytes", value<size_t>(&shardbytes)->default_value(0), "splits the output into shards of at most this number of (uncompressed) bytes of records, see --shard-variants. Can be combined with --shard-variants, the shard is completed as soon as one of the limits is reached.")
+    ("csi", "creates a CSI index instead of a tabix index for compressed VCF output (required for positions beyond 2^29)")
+    ("profile", value<vector<string>>(&profilestrs)->composing(), "named filter profile with its own output, as NAME:OUTFILE:OPTIONS, where OPTIONS are filter options of restorevcf separated by whitespace (e.g. \"pass:pass.vcf:--fpass --macfilter 4\"), OUTFILE \"-\" is stdout. Can be used several times, all profiles are restored in a single pass. The filter options outside of profiles are ignored then.")
+    ("threads,t", value<unsigned>(&nthreads)->default_value(1), "number of threads. Very wide lines (large number of samples) are scanned in parallel.")
+    ("input", value<vector<string>>(&inputs)->composing(), "extraction files of one chromosome (plain or gzip compressed), can also be given as positional arguments. If several files are given, they are restored concurrently (using the number of threads given by --threads) and written in the given order. If no file is given, the extraction is read from stdin. An original VCF (plain or gzip compressed) can be given instead of an extraction, which is then extracted in-process as by vcffilter.")
+    ("gq", "VCF input: extracts the GQ field in addition to GT (as vcffilter --gq)")
+    ("write-extraction", value<string>(&extractionout), "VCF input: writes the extraction created in-process to this file as well (gzip compressed if ending with .gz), as vcffilter would create it. Requires a single input.")
     ;
 
     opts_hidden.add_options()
@@ -158,7 +243,9 @@ void RestoreArgs::parse(int argc, char *argv[]) {
     all_options.add(opts_hidden);
 
     // do the actual parsing
-    store(command_line_parser(argc, argv).options(all_options).run(), vars);
+    positional_options_description positional;
+    positional.add("input", -1);
+    store(command_line_parser(argc, argv).options(all_options).positional(positional).run(), vars);
     notify(vars);
 
 }
@@ -177,6 +264,10 @@ void RestoreArgs::parseVars() {
         keepaa = true;
     if (vars.count("filterunknown"))
         filterunk = true;
+    if (vars.count("stats"))
+        stats = true;
+    if (vars.count("sites-only"))
+        sitesonly = true;
     if (vars.count("splitma")) {
         splitma = true;
         rminfo = true; // this is automatically set when --splitma is used
@@ -186,7 +277,77 @@ void RestoreArgs::parseVars() {
         keepaa = false;
     if (vars.count("makehap") && !hapidxfile.empty())
         makehap = true;
+    if (vars.count("noheader"))
+        noheader = true;
+    if (vars.count("csi"))
+        csi = true;
+    if (vars.count("gq"))
+        gq = true;
+    if (nthreads == 0)
+        nthreads = 1;
+
+}
+
+RestoreProfile RestoreArgs::toProfile(const string& name, const string& outfile) const {
+    RestoreProfile p;
+    p.name = name;
+    p.outfile = outfile;
+    p.fpass = fpass;
+    p.rminfo = rminfo;
+    p.keepaa = keepaa;
+    p.macfilter = macfilter;
+    p.maffilter = maffilter;
+    p.aafilter = aafilter;
+    p.missfilter = missfilter;
+    p.filterunk = filterunk;
+    p.splitma = splitma;
+    p.stats = stats;
+    p.hwefilter = hwefilter;
+    p.sitesonly = sitesonly;
+    return p;
+}
 
+/*static*/ RestoreProfile RestoreArgs::parseProfile(const string& profilestr) {
+    // NAME:OUTFILE:OPTIONS
+    size_t sep1 = profilestr.find(':');
+    size_t sep2 = sep1 == string::npos ? string::npos : profilestr.find(':', sep1+1);
+    if (sep1 == 0 || sep1 == string::npos || sep2 == sep1+1) {
+        cerr << "ERROR: Invalid profile \"" << profilestr << "\". Expecting NAME:OUTFILE:OPTIONS." << endl;
+        exit(EXIT_FAILURE);
+    }
+    string name = profilestr.substr(0, sep1);
+    string outfile = profilestr.substr(sep1+1, sep2 == string::npos ? string::npos : sep2-sep1-1);
+    string opts = sep2 == string::npos ? "" : profilestr.substr(sep2+1);
+
+    // parse the options with the same parser as the command line
+    vector<string> tokens(1, "restorevcf");
+    istringstream os(opts);
+    for (string t; os >> t; )
+        tokens.push_back(t);
+    vector<char*> pargv;
+    for (string& t : tokens)
+        pargv.push_back(&t[0]);
+    RestoreArgs pargs {(int) pargv.size(), pargv.data()};
+    pargs.parseVars();
+
+    // only filter options are allowed here
+    static const char* const filteropts[] = {"fpass", "rminfo", "keepaa", "macfilter", "maffilter", "aafilter", "missfilter", "filterunknown", "splitma", "stats", "hwefilter", "sites-only"};
+    for (const auto& v : pargs.vars) {
+        if (v.second.defaulted())
+            continue;
+        bool isfilter = false;
+        for (const char* f : filteropts)
+            isfilter |= v.first == f;
+        if (!isfilter) {
+            cerr << "ERROR: Option --" << v.first << " cannot be used in profile \"" << name << "\"." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (pargs.macfilter && pargs.maffilter > 0) {
+        cerr << "ERROR: MAC and MAF filter cannot be used together (profile \"" << name << "\")." << endl;
+        exit(EXIT_FAILURE);
+    }
+    return pargs.toProfile(name, outfile);
 }
 
 bool RestoreArgs::isDefined(const string &optname) const {
@@ -197,7 +358,7 @@ bool RestoreArgs::isDefined(const string &optname) const {
 }
 
 void RestoreArgs::printHelp(const string &progname, ostream &out) const {
-    out << "Usage: " << progname << " [options]" << endl << endl;
+    out << "Usage: " << progname << " [options] [extraction files]" << endl << endl;
     out << opts_regular << endl;
     if (debug) {
         out << opts_hidden << endl;
@@ -30,6 +30,27 @@ namespace bpo = boost::program_options;
 
 using namespace std;
 
+/**
+ * Filter and output options for one output of restorevcf.
+ */
+struct RestoreProfile {
+    string name;
+    string outfile = "-"; /**< "-" for stdout */
+    char outputtype = 'v'; /**< v: VCF, z: BGZF compressed VCF, b: BCF */
+    bool fpass = false;
+    bool rminfo = false;
+    bool keepaa = false;
+    size_t macfilter = 0;
+    float maffilter = 0;
+    float aafilter = 0;
+    float missfilter = 0;
+    bool filterunk = false;
+    bool splitma = false;
+    bool stats = false; /**< extended statistics (F_MISSING, HWE) in the INFO column */
+    float hwefilter = 0;
+    bool sitesonly = false; /**< only the site columns are written, without FORMAT and genotypes */
+};
+
 /**
  * Class for storing and retrieving command-line arguments.
  */
@@ -90,8 +111,30 @@ public:
     float missfilter = 0;
     bool filterunk = false;
     bool splitma = false;
+    bool stats = false;
+    float hwefilter = 0;
+    bool sitesonly = false;
     bool makehap = false;
     string hapidxfile;
+    string ploidyfile;
+    string excludefile;
+    string includefile;
+    string sampleheader;
+    string includesites;
+    string excludesites;
+    string groupsfile;
+    bool noheader = false;
+    string outfile;
+    string outputtype;
+    bool csi = false;
+    size_t shardvariants = 0;
+    size_t shardbytes = 0;
+    unsigned nthreads = 1;
+    vector<string> profilestrs;
+    vector<string> inputs; /**< extraction files, stdin if empty */
+    bool gq = false; /**< extract GQ from VCF input */
+    string extractionout; /**< sidecar file for the extraction created from VCF input */
+    vector<RestoreProfile> profiles; /**< outputs: either all named profiles or a single one from the filter options above */
 
     bool debug = false;
 
@@ -103,6 +146,8 @@ protected:
 
     void parse(int argc, char *argv[]);
     void parseVars();
+    RestoreProfile toProfile(const string& name, const string& outfile) const;
+    static RestoreProfile parseProfile(const string& profilestr);
     bool isDefined(const std::string &optname) const;
 
     bpo::options_description opts_regular;        /**< regular options, shown on help output */
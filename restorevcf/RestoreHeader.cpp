@@ -0,0 +1,110 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "RestoreHeader.h"
+#include "GTScan.h"
+
+// returns the ID of a "##INFO=<ID=..." line or an empty string if it is not an INFO description
+static string infoID(const string& l) {
+    if (l.compare(0, 11, "##INFO=<ID=") != 0)
+        return "";
+    size_t end = l.find_first_of(",>", 11);
+    return l.substr(11, end == string::npos ? string::npos : end - 11);
+}
+
+bool isRecalculatedInfo(const RestoreProfile& profile, const vector<string>& groupnames, const char* key, size_t keylen) {
+    if (keylen == 2 && key[0] == 'A' && (key[1] == 'F' || key[1] == 'C' || key[1] == 'N'))
+        return true;
+    if (profile.stats && ((keylen == 9 && memcmp(key, "F_MISSING", 9) == 0) || (keylen == 3 && memcmp(key, "HWE", 3) == 0)))
+        return true;
+    if (!groupnames.empty() && keylen > 3 && key[0] == 'A' && (key[1] == 'C' || key[1] == 'N') && key[2] == '_') {
+        for (const string& g : groupnames)
+            if (keylen - 3 == g.size() && memcmp(key + 3, g.data(), g.size()) == 0)
+                return true;
+    }
+    return false;
+}
+
+string restoreHeader(const vector<string>& hdr, const RestoreProfile& profile, const vector<unsigned char>& sampleactions, const string& command,
+        const vector<string>& groupnames) {
+    string out;
+    for (const string& l : hdr) {
+
+        string id = infoID(l);
+        if (!id.empty()) { // INFO description
+            if (isRecalculatedInfo(profile, groupnames, id.data(), id.size())) { // replaced by recalculated values
+                if (!profile.rminfo) { // original values are kept with prefix "Org"
+                    out.append(l, 0, 11);
+                    out.append("Org");
+                    out.append(l, 11, string::npos);
+                    out.push_back('\n');
+                }
+            } else if (!profile.rminfo || (profile.keepaa && id == "AAScore")) {
+                out.append(l);
+                out.push_back('\n');
+            }
+
+        } else if (l.compare(0, 6, "#CHROM") == 0) { // last line of the header
+            // descriptions of the recalculated fields
+            out.append("##INFO=<ID=AF,Number=A,Type=Float,Description=\"Allele frequency, recalculated by restorevcf\">\n");
+            out.append("##INFO=<ID=AC,Number=A,Type=Integer,Description=\"Allele count in genotypes, recalculated by restorevcf\">\n");
+            out.append("##INFO=<ID=AN,Number=1,Type=Integer,Description=\"Total number of alleles in called genotypes, recalculated by restorevcf\">\n");
+            if (profile.stats) {
+                out.append("##INFO=<ID=F_MISSING,Number=1,Type=Float,Description=\"Fraction of missing genotypes, calculated by restorevcf\">\n");
+                out.append("##INFO=<ID=HWE,Number=A,Type=Float,Description=\"Hardy-Weinberg equilibrium exact test p-value of the diploid genotypes for each alt allele, calculated by restorevcf\">\n");
+            }
+            for (const string& g : groupnames) {
+                out.append("##INFO=<ID=AC_" + g + ",Number=A,Type=Integer,Description=\"Allele count in genotypes of group " + g + ", calculated by restorevcf\">\n");
+                out.append("##INFO=<ID=AN_" + g + ",Number=1,Type=Integer,Description=\"Total number of alleles in called genotypes of group " + g + ", calculated by restorevcf\">\n");
+            }
+            // add header line indicating the use of this tool
+            out.append("##restorevcf_command=");
+            out.append(command);
+            out.push_back('\n');
+
+            // standard columns until FORMAT and all samples that are kept (only the site columns until INFO for sites-only output)
+            size_t col = 0;
+            size_t start = 0;
+            bool first = true;
+            while (start <= l.size()) {
+                size_t end = l.find('\t', start);
+                if (end == string::npos)
+                    end = l.size();
+                bool keep = profile.sitesonly ? col < 8 : col < 9 || col - 9 >= sampleactions.size() || sampleactions[col - 9] != SAMPLE_DROP;
+                if (keep) {
+                    if (!first)
+                        out.push_back('\t');
+                    out.append(l, start, end - start);
+                    first = false;
+                }
+                start = end + 1;
+                col++;
+            }
+            out.push_back('\n');
+
+        } else {
+            out.append(l);
+            out.push_back('\n');
+        }
+    }
+    return out;
+}
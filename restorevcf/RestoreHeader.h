@@ -0,0 +1,53 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESTOREHEADER_H_
+#define RESTOREHEADER_H_
+
+#include <string>
+#include <vector>
+
+#include "RestoreArgs.h"
+
+using namespace std;
+
+/**
+ * Creates the VCF header for the output of a profile from the header embedded in the extraction by vcffilter.
+ * The descriptions of the original AF, AC and AN fields are renamed to OrgAF, OrgAC and OrgAN (or removed with
+ * the other INFO descriptions, if the INFO column is removed) and descriptions of the recalculated fields are added,
+ * as well as a line with the command. Samples that are dropped (see SampleAction) are removed from the #CHROM line,
+ * for sites-only output the #CHROM line ends with the INFO column.
+ * The same applies to the extended statistics of the profile (F_MISSING, HWE) and the per-group counts (AC_GROUP, AN_GROUP).
+ * @param hdr embedded header lines (without newline)
+ * @param sampleactions action for each sample index
+ * @param command the command line of restorevcf
+ * @param groupnames names of the sample groups, if any
+ * @return the complete header including the #CHROM line and a final newline
+ */
+string restoreHeader(const vector<string>& hdr, const RestoreProfile& profile, const vector<unsigned char>& sampleactions, const string& command,
+        const vector<string>& groupnames);
+
+/**
+ * Returns true, if the INFO field with the given key is replaced by a value recalculated by restorevcf for the given profile
+ * (AF, AC, AN, the extended statistics and the per-group counts). The original values are kept with the prefix "Org".
+ */
+bool isRecalculatedInfo(const RestoreProfile& profile, const vector<string>& groupnames, const char* key, size_t keylen);
+
+#endif /* RESTOREHEADER_H_ */
@@ -0,0 +1,176 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "RestoreOutput.h"
+#include "NumParse.h"
+
+static inline uint32_t getLE32(const char* p) {
+    const unsigned char* u = (const unsigned char*) p;
+    return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t) u[3] << 24);
+}
+
+RestoreOutput::RestoreOutput(const string& filename_, char type_, const string& header_, const string& chrom_, int32_t tid_, bool csi_, ThreadPool* pool_,
+        size_t shardvariants_, size_t shardbytes_) :
+    filename(filename_),
+    type(type_),
+    header(header_),
+    chrom(chrom_),
+    tid(tid_),
+    csi(csi_),
+    pool(pool_),
+    shardvariants(shardvariants_),
+    shardbytes(shardbytes_),
+    sharding(shardvariants_ > 0 || shardbytes_ > 0)
+{
+    if (sharding) {
+        manifestfile = filename + ".manifest.tsv";
+        manifest = fopen(manifestfile.c_str(), "w");
+        if (manifest == NULL) {
+            cerr << "ERROR: Unable to open manifest file " << manifestfile << endl;
+            exit(EXIT_FAILURE);
+        }
+        fputs("#SHARD\tFIRST_POS\tLAST_POS\tVARIANTS\n", manifest);
+        fflush(manifest);
+    }
+    open();
+}
+
+RestoreOutput::~RestoreOutput() {
+    if (file)
+        close();
+}
+
+void RestoreOutput::open() {
+    if (sharding) {
+        char num[24];
+        snprintf(num, sizeof(num), ".%04zu", nshards);
+        name = filename + num + (type == 'b' ? ".bcf" : type == 'z' ? ".vcf.gz" : ".vcf");
+    } else
+        name = filename;
+    file = name == "-" ? stdout : fopen(name.c_str(), "w");
+    if (file == NULL) {
+        cerr << "ERROR: Unable to open output file " << name << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (type != 'v') {
+        bgzf = new BgzfWriter(file, pool);
+        // compressed files are indexed while they are written, BCF can only be indexed with CSI
+        if (file != stdout) {
+            bool usecsi = csi || type == 'b';
+            index = new BgzfIndex(usecsi ? BgzfIndex::CSI : BgzfIndex::TBI, type == 'b', chrom, tid);
+            indexfile = name + (usecsi ? ".csi" : ".tbi");
+        }
+    }
+    nshards++;
+    nvariants = 0;
+    nbytes = 0;
+    writeRaw(header.data(), header.size());
+}
+
+void RestoreOutput::closeFile() {
+    if (bgzf) {
+        bgzf->close();
+        if (index) {
+            index->write(indexfile, *bgzf);
+            delete index;
+            index = NULL;
+        }
+        delete bgzf;
+        bgzf = NULL;
+    }
+    if (file == stdout)
+        fflush(stdout);
+    else
+        fclose(file);
+    file = NULL;
+    if (sharding) {
+        if (nvariants)
+            fprintf(manifest, "%s\t%ld\t%ld\t%zu\n", name.c_str(), (long) firstpos, (long) lastpos, nvariants);
+        else
+            fprintf(manifest, "%s\t.\t.\t0\n", name.c_str());
+        fflush(manifest);
+    }
+}
+
+void RestoreOutput::close() {
+    closeFile();
+    if (manifest) {
+        fclose(manifest);
+        manifest = NULL;
+    }
+}
+
+void RestoreOutput::writeRaw(const char* data, size_t size) {
+    if (bgzf)
+        bgzf->write(data, size);
+    else
+        fwrite(data, 1, size, file);
+}
+
+void RestoreOutput::writeRecords(const char* data, size_t size) {
+    if (index)
+        index->scan(data, size, bgzf->tell());
+    writeRaw(data, size);
+}
+
+void RestoreOutput::write(const char* data, size_t size) {
+    if (!sharding) {
+        writeRecords(data, size);
+        return;
+    }
+
+    // rollover at record boundaries: the part of the data belonging to the current shard is written at once
+    const char* end = data + size;
+    const char* part = data;
+    for (const char* rec = data; rec < end;) {
+        const char* next;
+        int64_t pos = 0;
+        if (type == 'b') { // l_shared, l_indiv, CHROM, POS (0-based)
+            next = rec + 8 + getLE32(rec) + getLE32(rec + 4);
+            pos = (int64_t) (int32_t) getLE32(rec + 12) + 1;
+        } else {
+            const char* nl = (const char*) memchr(rec, '\n', end - rec);
+            next = nl ? nl + 1 : end;
+            const char* p = (const char*) memchr(rec, '\t', next - rec);
+            const char* pend = p ? (const char*) memchr(p + 1, '\t', next - p - 1) : NULL;
+            int32_t v;
+            if (pend && parseInt(p + 1, pend, v))
+                pos = v;
+        }
+        size_t reclen = next - rec;
+        if (nvariants && ((shardvariants && nvariants >= shardvariants) || (shardbytes && nbytes + reclen > shardbytes))) {
+            writeRecords(part, rec - part);
+            part = rec;
+            closeFile();
+            open();
+        }
+        if (nvariants == 0)
+            firstpos = pos;
+        lastpos = pos;
+        nvariants++;
+        nbytes += reclen;
+        rec = next;
+    }
+    writeRecords(part, end - part);
+}
@@ -0,0 +1,114 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESTOREOUTPUT_H_
+#define RESTOREOUTPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "Bgzf.h"
+#include "BgzfIndex.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+/**
+ * The output of a profile: plain VCF, or BGZF compressed VCF or BCF, which is indexed
+ * while it is written if the output is a file.
+ * If sharding is enabled, the output is split into several files of a limited number of variants
+ * or bytes, each with its own header (and index). The files are named PREFIX.NNNN.EXT and are listed
+ * in the manifest PREFIX.manifest.tsv with their first and last position and their number of variants.
+ * A shard is listed as soon as it is complete.
+ */
+class RestoreOutput {
+public:
+    /**
+     * @param filename output file ("-" for stdout), or the prefix of the shards if sharding is enabled
+     * @param type 'v' (VCF), 'z' (BGZF compressed VCF) or 'b' (BCF)
+     * @param header header printed at the beginning of each file (encoded for BCF), may be empty
+     * @param chrom the chromosome of all records
+     * @param tid ID of the chromosome in the BCF header (BCF only, for the index)
+     * @param csi use a CSI index instead of tabix for compressed VCF
+     * @param pool if not NULL, the compression runs on the workers of this pool
+     * @param shardvariants maximum number of variants per shard (0: no limit)
+     * @param shardbytes maximum number of (uncompressed) bytes of the records in a shard (0: no limit)
+     * Sharding is enabled, if one of the limits is set.
+     */
+    RestoreOutput(const string& filename, char type, const string& header, const string& chrom, int32_t tid, bool csi, ThreadPool* pool,
+            size_t shardvariants = 0, size_t shardbytes = 0);
+    ~RestoreOutput();
+
+    RestoreOutput(const RestoreOutput&) = delete;
+    RestoreOutput& operator=(const RestoreOutput&) = delete;
+
+    /** Writes complete records (lines for VCF). */
+    void write(const char* data, size_t size);
+
+    /** Completes the (last) file and its index. */
+    void close();
+
+    /** Number of written files (shards) */
+    size_t numShards() const { return nshards; }
+
+    /** Name of the manifest file, if sharding is enabled */
+    const string& manifestName() const { return manifestfile; }
+
+private:
+    // opens the next file and writes the header
+    void open();
+    // completes the current file, its index and its entry in the manifest
+    void closeFile();
+    // writes to the current file
+    void writeRaw(const char* data, size_t size);
+    // writes complete records to the current file and adds them to the index
+    void writeRecords(const char* data, size_t size);
+
+    string filename;
+    char type;
+    string header;
+    string chrom;
+    int32_t tid;
+    bool csi;
+    ThreadPool* pool;
+    size_t shardvariants;
+    size_t shardbytes;
+    bool sharding;
+
+    // current file
+    string name;
+    FILE* file = NULL;
+    BgzfWriter* bgzf = NULL;
+    BgzfIndex* index = NULL;
+    string indexfile;
+
+    // current shard
+    size_t nshards = 0;
+    size_t nvariants = 0;
+    size_t nbytes = 0;
+    int64_t firstpos = 0;
+    int64_t lastpos = 0;
+    string manifestfile;
+    FILE* manifest = NULL;
+};
+
+#endif /* RESTOREOUTPUT_H_ */
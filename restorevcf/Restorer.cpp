@@ -0,0 +1,584 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include "Restorer.h"
+#include "GTRecode.h"
+#include "GTScan.h"
+#include "NumParse.h"
+#include "RestoreHeader.h"
+
+// appends an unsigned integer
+static inline void appendUInt(string& out, size_t v) {
+    char buf[24];
+    char* end = to_chars(buf, buf+sizeof(buf), v).ptr;
+    out.append(buf, end);
+}
+
+// appends a float with 8 decimal places (same as printf's "%.8f")
+static inline void appendFloat8(string& out, float v) {
+    char buf[64];
+    char* end = to_chars(buf, buf+sizeof(buf), v, chars_format::fixed, 8).ptr;
+    out.append(buf, end);
+}
+
+// appends a float with 6 significant digits (same as printf's "%g")
+static inline void appendFloatG(string& out, float v) {
+    char buf[64];
+    char* end = to_chars(buf, buf+sizeof(buf), v, chars_format::general, 6).ptr;
+    out.append(buf, end);
+}
+
+Restorer::Restorer(const vector<RestoreProfile>& profiles_, const string& chrom_, bool parsegq_, const PloidyMap& ploidymap_, const SiteFilter* sitefilter_,
+        const vector<const BcfHeader*>& bcfheaders_, const SampleGroups* groups_, ThreadPool* scanpool_) :
+    counters(profiles_.size()),
+    profiles(profiles_),
+    bcfheaders(bcfheaders_),
+    chrom(chrom_),
+    parsegq(parsegq_),
+    ploidymap(ploidymap_),
+    curseg(ploidymap_.find(0)),
+    sitefilter(sitefilter_),
+    scanpool(scanpool_),
+    groups(groups_)
+{
+    // reserve space for allele counters
+    nac = 10;
+    ac = (size_t*) malloc(nac * sizeof(size_t));
+
+    needinfoidx = false;
+    needaa = false;
+    needstats = groups != NULL;
+    countonly = true;
+    for (const auto& p : profiles) {
+        needinfoidx |= p.aafilter > 0 || p.keepaa || !p.rminfo;
+        needaa |= p.aafilter > 0 || p.keepaa;
+        needstats |= p.stats || p.hwefilter > 0;
+        countonly &= p.sitesonly;
+    }
+    // the extended statistics are counted on the rewritten genotypes
+    countonly &= !needstats;
+    if (groups) {
+        groupnames = groups->names;
+        for (const string& g : groupnames) {
+            groupkeys.push_back("AC_" + g);
+            groupkeys.push_back("AN_" + g);
+        }
+        vstats.groups = &groups->groups;
+        vstats.ngroups = groupnames.size();
+    }
+    active.resize(profiles.size());
+    gtinplace = profiles.size() == 1;
+    bcfheaders.resize(profiles.size(), NULL);
+}
+
+Restorer::~Restorer() {
+    free(ac);
+}
+
+const char* Restorer::getSplitGT(size_t a) {
+    if (magts[a] == NULL) {
+        if (a == 0 && gtinplace) // the genotypes of the line are not required anymore
+            magts[a] = gtstart;
+        else
+            magts[a] = (char*) malloc(gtsize * sizeof(char));
+        if (magts.size() < 10) // single digit allele indices: recode whole blocks
+            (parsegq ? recodeGTFields : recodeGT)(magts[a], gtstart, gtsize, a+1);
+        else // allele indices with more than one digit: the recoded genotypes are compacted
+            recodeGTMulti(magts[a], gtstart, gtsize-1, a+1, parsegq);
+    }
+    return magts[a];
+}
+
+void Restorer::processLine(char* line, size_t nline, string* outs) {
+
+    // genomic position
+    char* pos = line;
+    char* posend = strchr(pos, '\t'); // end of genomic position (exclusive, points to tab char)
+    if (posend == NULL) // no tab char -> invalid line (can happen for the last line when it contains only a newline character, or when concatenating files the header of the new file) -> skip
+        return;
+    if (*line == '#') // embedded VCF header of a concatenated file -> skip
+        return;
+    for (auto& c : counters)
+        c.nread++;
+
+    // variant ID
+    char* varid = posend+1;
+    char* varidend = strchr(varid, '\t');
+
+    // alleles
+    char* refall = varidend+1;
+    char* refallend = strchr(refall, '\t'); // end of first allele (exclusive)
+    char* altallend = strchr(refallend+1, '\t'); // end of alternative alleles (exclusive)
+
+    // site list
+    if (sitefilter && !sitefilter->selected(chrom, pos, posend, varid, varidend, refall, refallend, refallend+1, altallend, keybuf)) {
+        for (auto& c : counters)
+            c.nsiteskip++;
+        return;
+    }
+
+    // switch the per-sample actions when entering another segment of the ploidy map
+    if (ploidymap.size() > 1) {
+        size_t p;
+        if (parseUInt(pos, posend, p) && (p < curseg->start || p >= curseg->end))
+            curseg = ploidymap.find(p);
+    }
+    bool modify = curseg->anymod; // apply per-sample actions at this position
+
+    // count number of alternative alles + check if unknown + prepare split
+    size_t nalt = 0;
+    int unkidx = -1; // points to the alt allele which is unknown (-1 if none)
+    altstarts.clear();
+    altends.clear();
+    for (char* t = refallend; t != altallend; ) { // t always points to the delimiter before the current allele (also at the beginning)!
+        char* aend = (char*) memchr(t+1, ',', altallend - (t+1));
+        if (aend == NULL)
+            aend = altallend;
+        if (*(t+1) == '*') // found unknown allele
+            unkidx = nalt;
+        altstarts.push_back(t+1);
+        altends.push_back(aend);
+        nalt++;
+        t = aend;
+    }
+
+    // initialize allele counters
+    if (nalt > nac) {
+        ac = (size_t*) realloc(ac, nalt * sizeof(size_t));
+        nac = nalt;
+    }
+    for (size_t i = 0; i < nalt; i++)
+        ac[i] = 0;
+
+    // qual field
+    char* qual = altallend+1; // start
+    char* qualend = strchr(qual, '\t'); // end (exclusive)
+
+    // filter field
+    char* filter = qualend+1; // start of filter field
+    char* filterend = strchr(filter, '\t'); // end of filter (exclusive)
+    *filterend = '\0'; // null terminate filter field, as we are going to modify the following INFO fields for printing
+    bool filterpass = strcmp(filter, "PASS") == 0;
+
+    // info
+    char* info = filterend+1; // start
+    char* infoend = strchr(info, '\t'); // end
+    *infoend = '\0'; // null terminate INFO field
+    if (needinfoidx)
+        infoidx.parse(info, infoend); // single pass over INFO, serves all INFO field lookups below
+
+    // AAScores for all alt alleles
+    const InfoIndex::Field* aaf = NULL; // AAScore field, if present
+    if (needaa) {
+        aaf = infoidx.find("AAScore");
+        aascores.assign(nalt, NAN);
+        aastarts.assign(nalt, NULL);
+        aaends.assign(nalt, NULL);
+        char* aatmp = aaf != NULL ? aaf->val : NULL; // beginning of first value
+        for (size_t n = 0; aatmp != NULL && n < nalt; n++) {
+            char* aaend = NULL;
+            if (aatmp <= aaf->end && n < nalt-1) // more than one alt allele
+                aaend = (char*) memchr(aatmp, ',', aaf->end - aatmp); // will be found in a proper VCF
+            if (aaend == NULL)
+                aaend = aaf->end; // end of AAScore field
+            if (aatmp > aaend) // fewer values than alleles
+                aatmp = aaend;
+            aastarts[n] = aatmp;
+            aaends[n] = aaend;
+            if (!parseFloat(aatmp, aaend, aascores[n])) // e.g. missing value
+                aascores[n] = NAN; // will not pass the filter
+            aatmp = aaend + 1; // beginning of next value
+        }
+    }
+
+    // filters that do not depend on the genotypes
+    size_t nactive = 0;
+    size_t lastactive = 0;
+    for (size_t p = 0; p < profiles.size(); p++) {
+        const RestoreProfile& prof = profiles[p];
+        RestoreCounters& cnt = counters[p];
+        active[p] = false;
+
+        // filter single unknown "*" alleles
+        if (prof.filterunk && unkidx >= 0 && nalt == 1) { // filter is activated and an unknown allele was found which is the only alt allele
+            cnt.nskip++;
+            continue; // skip this line
+        } // else if there was an unknown allele together in a multi-allelic context, we filter it later
+
+        bool masplitnow = prof.splitma && nalt > 1;
+        if (masplitnow)
+            cnt.nsplit++;
+
+        // FILTER == PASS filter
+        if (prof.fpass && !filterpass) {
+            cnt.nskip += masplitnow ? nalt : 1;
+            continue; // skip this line
+        }
+
+        // AAScore filter (if there is no AAScore, the variant does not pass the AAScore filter)
+        if (prof.aafilter > 0) {
+            bool pass = false;
+            for (size_t n = 0; aaf != NULL && n < nalt; n++)
+                pass |= aascores[n] >= prof.aafilter;
+            if (!pass) { // all AAScores are below the threshold
+                cnt.nskip += masplitnow ? nalt : 1;
+                continue; // skip this line
+            }
+        }
+
+        active[p] = true;
+        nactive++;
+        lastactive = p;
+    }
+    if (nactive == 0) // filtered by all profiles
+        return;
+
+    // genotypes
+    gtstart = infoend+1; // start of genotypes (pointing at first gt char!)
+    gtsize = (line + nline) - gtstart + 1; // size of genotype block including null terminator
+    GTScan scan;
+    scan.gtstart = gtstart;
+    scan.nalt = nalt;
+    scan.ac = ac;
+    scan.actions = &curseg->actions;
+    scan.countonly = countonly;
+    // early abort if the filters cannot be passed anymore (only if a single profile remains)
+    if (nactive == 1) {
+        const RestoreProfile& prof = profiles[lastactive];
+        scan.gtend = line + nline;
+        scan.missfilter = prof.missfilter;
+        scan.macfilter = prof.macfilter;
+        scan.maffilter = prof.maffilter;
+    }
+    if (scanpool && gtsize >= PARALLEL_SCAN_MINSIZE) // very wide line
+        scanGenotypesParallel(scan, line + nline, modify, parsegq, *scanpool);
+    else
+        scanGenotypes(scan, modify, parsegq);
+    if (scan.aborted) { // the line fails the missingness or MAC/MAF filter anyway
+        counters[lastactive].nskip += profiles[lastactive].splitma && nalt > 1 ? nalt : 1;
+        return;
+    }
+    if (modify && !countonly) // genotypes were compacted
+        gtsize = scan.gtlen + 1;
+    size_t an = scan.an;
+    size_t nhap = scan.nhap;
+    size_t ngtmiss = scan.ngtmiss;
+    magts.assign(nalt > 1 ? nalt : 0, NULL);
+
+    // extended statistics from the final genotypes
+    if (needstats) {
+        vstats.reset(nalt);
+        scanStats(vstats, gtstart, gtstart + gtsize - 1);
+        hwes.resize(nalt);
+        for (size_t n = 0; n < nalt; n++)
+            hwes[n] = vstats.hwe(n);
+    }
+
+    for (size_t p = 0; p < profiles.size(); p++) {
+        if (!active[p])
+            continue;
+        const RestoreProfile& prof = profiles[p];
+        RestoreCounters& cnt = counters[p];
+        string& out = outs[p];
+
+        // prepare for ma splits
+        bool masplitnow = prof.splitma && nalt > 1;
+        if (masplitnow) { // multi-allelic variant that needs to be split
+            // initialize the flags for which allele should be filtered -> default: not filtered
+            maaltfilter.assign(nalt, false);
+            if (prof.filterunk && unkidx >= 0) // if there's an unknown allele to be filtered, mark it already
+                maaltfilter[unkidx] = true;
+            if (prof.aafilter > 0) { // mark alleles below the AAScore threshold
+                for (size_t n = 0; n < nalt; n++) {
+                    if (!(aascores[n] >= prof.aafilter))
+                        maaltfilter[n] = true;
+                }
+            }
+        }
+
+        // GT missingness filter
+        if (prof.missfilter > 0) {
+            if (ngtmiss / (float) nhap >= prof.missfilter) {
+                // skip this line
+                if (!masplitnow) {
+                    cnt.nskip++;
+                    continue;
+                } else // we set all filters to '1'
+                    maaltfilter.assign(nalt, true);
+            }
+        }
+
+        // MAC/MAF filter
+        if (prof.macfilter || prof.maffilter > 0) {
+            bool pass = false;
+            size_t mac = 0;
+            size_t minmac = prof.macfilter;
+            if (prof.maffilter > 0) { // set min MAC according to MAF filter
+                minmac = (size_t) ceil(prof.maffilter * an);
+            }
+            // iterate over all alt alleles
+            for (size_t n = 0; n < nalt; n++) {
+                // check minor(!) allele count
+                mac = (ac[n] <= an/2) ? ac[n] : an - ac[n];
+                if (mac >= (size_t) minmac) {
+                    pass = true;
+                    if (!masplitnow) // if we are not splitting MA's here, we can stop
+                        break;
+                } else if (masplitnow) { // value below threshold and we are splitting MA here
+                    // mark this allele to be filtered later
+                    maaltfilter[n] = true;
+                }
+            }
+            if (!pass && !masplitnow) { // all MAC's are below the threshold
+                cnt.nskip++;
+                continue; // skip this line
+            } // else all filters were already set to '1'
+        }
+
+        // HWE filter (all alt alleles have to pass, or each allele separately when splitting)
+        if (prof.hwefilter > 0) {
+            bool pass = true;
+            for (size_t n = 0; n < nalt; n++) {
+                if (hwes[n] < prof.hwefilter) {
+                    pass = false;
+                    if (masplitnow) // mark this allele to be filtered later
+                        maaltfilter[n] = true;
+                    else
+                        break;
+                }
+            }
+            if (!pass && !masplitnow) {
+                cnt.nskip++;
+                continue; // skip this line
+            }
+        }
+
+        // recode the genotypes of the split alleles that passed the filters
+        // (the first alt allele last, as it may be recoded in-place)
+        if (masplitnow && !prof.sitesonly) {
+            for (size_t a = nalt; a > 0; a--) {
+                if (!maaltfilter[a-1])
+                    getSplitGT(a-1);
+            }
+        }
+
+        // *****************
+        // print VCF line(s)
+        // *****************
+
+        size_t a = 0;
+        do { // for each alt allele, if we split an MA, or only once if not
+
+            if (!masplitnow || !maaltfilter[a]) { // only, if we do not filter this variant
+
+                if (bcfheaders[p] != NULL) { // encode a BCF record
+                    const BcfHeader& bh = *bcfheaders[p];
+                    bcfrec.begin(bh, pos, posend, varid, varidend, refall, refallend, qual, qualend);
+                    for (size_t n = masplitnow ? a : 0; n < (masplitnow ? a+1 : nalt); n++)
+                        bcfrec.addAllele(altstarts[n], altends[n]);
+                    bcfrec.setFilter(filter, filterend);
+
+                    // INFO: self generated values
+                    size_t nval = masplitnow ? 1 : nalt;
+                    afs.resize(nval);
+                    for (size_t n = 0; n < nval; n++)
+                        afs[n] = ac[a+n] / (float) an;
+                    bcfrec.addInfoFloats(bh.afid, afs.data(), nval);
+                    bcfrec.addInfoInts(bh.acid, ac + a, nval);
+                    bcfrec.addInfoInts(bh.anid, &an, 1);
+
+                    // extended statistics
+                    if (prof.stats) {
+                        float fmiss = vstats.fmissing();
+                        bcfrec.addInfoFloats(bh.info("F_MISSING", 9)->id, &fmiss, 1);
+                        bcfrec.addInfoFloats(bh.info("HWE", 3)->id, hwes.data() + a, nval);
+                    }
+                    for (size_t g = 0; g < groupnames.size(); g++) {
+                        const string& ackey = groupkeys[2*g];
+                        const string& ankey = groupkeys[2*g+1];
+                        bcfrec.addInfoInts(bh.info(ackey.data(), ackey.size())->id, vstats.groupac.data() + g * nalt + a, nval);
+                        bcfrec.addInfoInts(bh.info(ankey.data(), ankey.size())->id, &vstats.groupan[g], 1);
+                    }
+
+                    // original values
+                    if (!prof.rminfo) { // the replaced ones are prefixed with "Org"
+                        for (const auto& f : infoidx.fields) {
+                            if (isRecalculatedInfo(prof, groupnames, f.key, f.keylen)) {
+                                orgkey.assign("Org");
+                                orgkey.append(f.key, f.keylen);
+                                bcfrec.addInfo(orgkey.data(), orgkey.size(), f.val, f.end);
+                            } else if (!(f.keylen == 1 && *f.key == '.')) // not the missing value
+                                bcfrec.addInfo(f.key, f.keylen, f.val, f.end);
+                        }
+                    } else if (prof.keepaa && aaf != NULL) { // AAScore for the current allele or all alleles
+                        if (masplitnow)
+                            bcfrec.addInfo("AAScore", 7, aastarts[a], aaends[a]);
+                        else
+                            bcfrec.addInfo("AAScore", 7, aaf->val, aaf->end);
+                    }
+
+                    // genotypes (the recoded genotypes of a split may be shorter, but end with a newline as well)
+                    if (!prof.sitesonly) {
+                        const char* gts = masplitnow ? magts[a] : gtstart;
+                        bcfrec.setGenotypes(gts, gts + gtsize - 1);
+                    }
+                    bcfrec.end(out);
+                    cnt.nundefined += bcfrec.nundefined;
+                    bcfrec.nundefined = 0;
+
+                } else { // VCF line
+                    // CHROM (chromosome name)
+                    out.append(chrom);
+                    out.push_back('\t');
+
+                    if (masplitnow) { // POS, ID, ref allele, current alt allele, QUAL, FILTER
+                        out.append(pos, refallend);
+                        out.push_back('\t');
+                        out.append(altstarts[a], altends[a]);
+                        out.push_back('\t');
+                        out.append(qual); // prints QUAL + FILTER
+                    } else // POS, ID, ref allele + alt alleles, QUAL, FILTER
+                        out.append(pos);
+
+                    // INFO
+                    // print self generated values
+                    float anf = (float) an;
+                    out.append("\tAF=");
+                    appendFloat8(out, ac[a]/anf); // AF of first alt allele
+                    if (!masplitnow) {
+                        for (size_t n = 1; n < nalt; n++) {
+                            out.push_back(',');
+                            appendFloat8(out, ac[n]/anf); // AF of further alleles if multi-allelic
+                        }
+                    }
+                    out.append(";AC=");
+                    appendUInt(out, ac[a]); // AC of first alt allele
+                    if (!masplitnow) {
+                        for (size_t n = 1; n < nalt; n++) {
+                            out.push_back(',');
+                            appendUInt(out, ac[n]); // AC of further alleles if multi-allelic
+                        }
+                    }
+                    out.append(";AN=");
+                    appendUInt(out, an); // AN
+
+                    // extended statistics
+                    if (prof.stats) {
+                        out.append(";F_MISSING=");
+                        appendFloatG(out, vstats.fmissing());
+                        out.append(";HWE=");
+                        appendFloatG(out, hwes[a]);
+                        if (!masplitnow) {
+                            for (size_t n = 1; n < nalt; n++) {
+                                out.push_back(',');
+                                appendFloatG(out, hwes[n]);
+                            }
+                        }
+                    }
+                    for (size_t g = 0; g < groupnames.size(); g++) {
+                        const size_t* gac = vstats.groupac.data() + g * nalt;
+                        out.push_back(';');
+                        out.append(groupkeys[2*g]);
+                        out.push_back('=');
+                        appendUInt(out, gac[a]);
+                        if (!masplitnow) {
+                            for (size_t n = 1; n < nalt; n++) {
+                                out.push_back(',');
+                                appendUInt(out, gac[n]);
+                            }
+                        }
+                        out.push_back(';');
+                        out.append(groupkeys[2*g+1]);
+                        out.push_back('=');
+                        appendUInt(out, vstats.groupan[g]);
+                    }
+
+                    // original values
+                    if (!prof.rminfo) { // take over all original values -> no MA split possible here
+                        if (info != infoend) { // info is not empty
+                            out.push_back(';');
+
+                            // print INFO and prefix the original values of the replaced ones above with "Org"
+                            char* infoit = info;
+                            for (const auto& f : infoidx.fields) {
+                                if (isRecalculatedInfo(prof, groupnames, f.key, f.keylen)) {
+                                    out.append(infoit, f.key - infoit);
+                                    out.append("Org");
+                                    infoit = f.key;
+                                }
+                            }
+                            // print remainder
+                            out.append(infoit);
+                        }
+                    } else if (prof.keepaa) { // remove all original, but keep AAScore
+                        if (aaf != NULL) { // AAScore is present (already detected before)
+                            out.append(";AAScore=");
+                            out.append(aastarts[a], aaends[a]); // print AAScore for current allele
+                            if (!masplitnow) { // print all values for the other alleles as well
+                                for (size_t n = 1; n < nalt; n++) {
+                                    out.push_back(',');
+                                    out.append(aastarts[n], aaends[n]);
+                                }
+                            }
+                        }
+                    }
+
+                    if (prof.sitesonly) // no FORMAT and genotypes
+                        out.push_back('\n');
+                    else {
+                        // FORMAT
+                        if (parsegq)
+                            out.append("\tGT:GQ\t");
+                        else
+                            out.append("\tGT\t");
+
+                        // genotypes (all buffers end with newline!)
+                        if (masplitnow)
+                            out.append(magts[a]);
+                        else
+                            out.append(gtstart, gtsize-1);
+                    }
+
+                }
+
+                cnt.nprint++;
+
+            } else { // this variant is filtered from a multi-allelic split
+                cnt.nskip++;
+            }
+            a++;
+
+        } while(masplitnow && a < nalt); // for each alt allele, if we split an MA, or only once if not
+
+        cnt.nhapconflicts += scan.nhapconflicts;
+    }
+
+    // cleanup for MA splits
+    for (size_t a = 0; a < magts.size(); a++) {
+        if (magts[a] && magts[a] != gtstart)
+            free(magts[a]);
+    }
+
+}
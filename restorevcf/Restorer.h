@@ -0,0 +1,150 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESTORER_H_
+#define RESTORER_H_
+
+#include <string>
+#include <vector>
+
+#include "RestoreArgs.h"
+#include "InfoIndex.h"
+#include "ThreadPool.h"
+#include "PloidyMap.h"
+#include "SiteFilter.h"
+#include "Bcf.h"
+#include "VarStats.h"
+
+using namespace std;
+
+/**
+ * Counters for one output profile.
+ */
+struct RestoreCounters {
+    size_t nread = 0;
+    size_t nprint = 0;
+    size_t nskip = 0;
+    size_t nsplit = 0;
+    size_t nhapconflicts = 0;
+    size_t nsiteskip = 0; /**< variants skipped due to the site list */
+    size_t nundefined = 0; /**< INFO fields and filters not written to BCF records as they are not defined in the header */
+
+    RestoreCounters& operator+=(const RestoreCounters& other) {
+        nread += other.nread;
+        nprint += other.nprint;
+        nskip += other.nskip;
+        nsplit += other.nsplit;
+        nhapconflicts += other.nhapconflicts;
+        nsiteskip += other.nsiteskip;
+        nundefined += other.nundefined;
+        return *this;
+    }
+};
+
+/**
+ * Restores VCF lines from the lines of an extraction and applies the filters.
+ * The genotypes of a line are scanned once, the filters and formatting of each profile are applied
+ * to the scan results, so several outputs can be created in a single pass.
+ * An instance keeps its own working memory and counters, so several instances
+ * can process lines concurrently.
+ */
+class Restorer {
+public:
+    /**
+     * @param profiles filter options for each output
+     * @param chrom chromosome name from the extraction header
+     * @param parsegq set, if the extraction contains the GQ field
+     * @param ploidymap per-sample actions, e.g. conversion to haploid, depending on the position
+     * @param sitefilter if not NULL, only variants selected by this filter are restored
+     * @param bcfheaders for each profile the header of the BCF output, or NULL (or empty) for VCF output
+     * @param groups if not NULL, the allele counts of each sample group are added (the sample indices refer to the samples in the output)
+     * @param scanpool if not NULL, the genotypes of very wide lines are scanned in parallel using this pool
+     */
+    Restorer(const vector<RestoreProfile>& profiles, const string& chrom, bool parsegq, const PloidyMap& ploidymap, const SiteFilter* sitefilter,
+            const vector<const BcfHeader*>& bcfheaders, const SampleGroups* groups, ThreadPool* scanpool = NULL);
+    ~Restorer();
+
+    Restorer(const Restorer&) = delete;
+    Restorer& operator=(const Restorer&) = delete;
+
+    /**
+     * Processes one line of the extraction and appends the restored VCF line(s) for each profile to the corresponding output.
+     * The line is modified during the process.
+     * @param line null terminated line (including the newline character)
+     * @param nline length of the line (including the newline character)
+     * @param outs one output for each profile
+     */
+    void processLine(char* line, size_t nline, string* outs);
+
+    /** counters for each profile */
+    vector<RestoreCounters> counters;
+
+private:
+    // returns the genotypes recoded for the given alt allele of a multi-allelic split (created on first use)
+    const char* getSplitGT(size_t a);
+
+    const vector<RestoreProfile>& profiles;
+    vector<const BcfHeader*> bcfheaders;
+    BcfRecord bcfrec;      // working memory for encoding BCF records
+    vector<float> afs;     // allele frequencies for BCF records
+    string orgkey;         // key of an original INFO value with prefix "Org"
+
+    string chrom;
+    bool parsegq;
+    const PloidyMap& ploidymap;
+    const PloidyMap::Segment* curseg; // segment of the ploidy map for the current position
+    const SiteFilter* sitefilter;
+    string keybuf; // working memory for the site filter
+    ThreadPool* scanpool;
+
+    // extended statistics
+    const SampleGroups* groups;
+    vector<string> groupkeys;   // INFO keys AC_GROUP and AN_GROUP for each group (alternating)
+    vector<string> groupnames;  // names of the groups (empty if there are no groups)
+    bool needstats;             // at least one profile requires the extended statistics
+    bool countonly;             // the genotypes are only counted, not rewritten (all profiles are sites-only)
+    VarStats vstats;
+    vector<float> hwes;         // HWE p-value for each alt allele
+
+    // allele counters
+    // (we use directly allocated memory here as it is significantly faster than a vector!)
+    size_t nac;
+    size_t* ac;
+
+    // index of the INFO fields (reused for each line)
+    InfoIndex infoidx;
+    bool needinfoidx;
+    bool needaa;
+
+    // state of the current line (reused for each line)
+    vector<char*> altstarts;     // beginning of each alt allele
+    vector<char*> altends;       // end of each alt allele (exclusive)
+    vector<float> aascores;      // AAScore for each alt allele (NAN if missing)
+    vector<char*> aastarts;      // beginning of each AAScore value
+    vector<char*> aaends;        // end of each AAScore value (exclusive)
+    vector<unsigned char> active; // profiles which have not filtered the line before the genotype scan
+    vector<bool> maaltfilter;    // alleles filtered from a multi-allelic split
+    vector<char*> magts;         // recoded genotypes for each alt allele of a multi-allelic split
+    char* gtstart;
+    size_t gtsize;
+    bool gtinplace;              // allele 1 may be recoded in place (single profile)
+};
+
+#endif /* RESTORER_H_ */
@@ -0,0 +1,123 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "SiteFilter.h"
+
+// initial number of slots (power of 2)
+#define SITESET_INITSIZE 1024
+
+SiteSet::SiteSet() :
+    offsets(1, 0),
+    table(SITESET_INITSIZE, 0),
+    mask(SITESET_INITSIZE - 1)
+{}
+
+void SiteSet::insert(const char* key, size_t len) {
+    if (contains(key, len))
+        return;
+    if (2 * (size() + 1) > table.size()) // keep the load factor below 0.5
+        grow();
+    uint64_t h = hash(key, len);
+    hashes.push_back(h);
+    pool.insert(pool.end(), key, key + len);
+    offsets.push_back(pool.size());
+    size_t slot = h & mask;
+    while (table[slot])
+        slot = (slot + 1) & mask;
+    table[slot] = hashes.size(); // index + 1
+}
+
+void SiteSet::grow() {
+    table.assign(2 * table.size(), 0);
+    mask = table.size() - 1;
+    for (size_t k = 0; k < hashes.size(); k++) {
+        size_t slot = hashes[k] & mask;
+        while (table[slot])
+            slot = (slot + 1) & mask;
+        table[slot] = k + 1;
+    }
+}
+
+SiteFilter::SiteFilter(const string& filename, bool include_) :
+    include(include_),
+    haskeys(false)
+{
+    FILE* f = fopen(filename.c_str(), "r");
+    if (!f) {
+        cerr << "ERROR: Unable to open sites file " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    char* line = NULL;
+    size_t len = 0;
+    ssize_t nl;
+    while ((nl = getline(&line, &len, f)) != -1) {
+        char* end = line + nl;
+        while (end != line && (*(end-1) == '\n' || *(end-1) == '\r'))
+            end--;
+        if (end == line || *line == '#')
+            continue;
+        sites.insert(line, end - line);
+        haskeys |= count(line, end, ':') == 3;
+    }
+    free(line);
+    fclose(f);
+}
+
+bool SiteFilter::selected(const string& chrom, const char* pos, const char* posend, const char* id, const char* idend,
+        const char* ref, const char* refend, const char* alt, const char* altend, string& keybuf) const {
+
+    bool found = sites.contains(id, idend - id);
+
+    if (!found && haskeys) {
+        // CHR:POS:REF:ALT with the complete ALT column
+        keybuf.assign(chrom);
+        keybuf.push_back(':');
+        keybuf.append(pos, posend);
+        keybuf.push_back(':');
+        keybuf.append(ref, refend);
+        keybuf.push_back(':');
+        size_t prefix = keybuf.size();
+        keybuf.append(alt, altend);
+        found = sites.contains(keybuf.data(), keybuf.size());
+
+        // each single alt allele of a multi-allelic variant
+        const char* a = alt;
+        while (!found && a < altend) {
+            const char* aend = (const char*) memchr(a, ',', altend - a);
+            if (aend == NULL) {
+                if (a == alt) // bi-allelic, already checked
+                    break;
+                aend = altend;
+            }
+            keybuf.resize(prefix);
+            keybuf.append(a, aend);
+            found = sites.contains(keybuf.data(), keybuf.size());
+            a = aend + 1;
+        }
+    }
+
+    return found == include;
+}
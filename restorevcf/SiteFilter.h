@@ -0,0 +1,106 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SITEFILTER_H_
+#define SITEFILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Open-addressing hash set of strings (linear probing).
+ * The strings are stored consecutively in a single pool, the table only holds their indices.
+ */
+class SiteSet {
+public:
+    SiteSet();
+
+    /** Inserts the key (if not already present). */
+    void insert(const char* key, size_t len);
+
+    /** Returns true, if the key is in the set. */
+    bool contains(const char* key, size_t len) const {
+        uint64_t h = hash(key, len);
+        for (size_t slot = h & mask; table[slot]; slot = (slot + 1) & mask) {
+            size_t k = table[slot] - 1;
+            if (hashes[k] == h && offsets[k+1] - offsets[k] == len && memcmp(pool.data() + offsets[k], key, len) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    /** Number of keys */
+    size_t size() const { return hashes.size(); }
+
+private:
+    // FNV-1a
+    static uint64_t hash(const char* key, size_t len) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < len; i++) {
+            h ^= (unsigned char) key[i];
+            h *= 1099511628211ull;
+        }
+        return h ^ (h >> 32);
+    }
+
+    void grow();
+
+    vector<char> pool;        // all keys
+    vector<size_t> offsets;   // beginning of each key in the pool, plus the end of the last one
+    vector<uint64_t> hashes;  // hash of each key
+    vector<uint32_t> table;   // key index + 1 in each slot, 0 for an empty slot
+    size_t mask;
+};
+
+/**
+ * Selects variants by a list of sites, given either by their IDs or by CHR:POS:REF:ALT keys.
+ * For multi-allelic variants, a key matches the complete ALT column as well as each single alt allele.
+ */
+class SiteFilter {
+public:
+    /**
+     * Loads the sites from a file, one per line.
+     * Exits with an error message if the file cannot be opened.
+     * @param include if set, only the listed sites are selected, otherwise the listed sites are removed
+     */
+    SiteFilter(const string& filename, bool include);
+
+    /**
+     * Returns true, if the variant is selected.
+     * keybuf is working memory for creating the keys.
+     */
+    bool selected(const string& chrom, const char* pos, const char* posend, const char* id, const char* idend,
+            const char* ref, const char* refend, const char* alt, const char* altend, string& keybuf) const;
+
+    /** Number of loaded sites */
+    size_t size() const { return sites.size(); }
+
+private:
+    SiteSet sites;
+    bool include;
+    bool haskeys; // at least one entry has the CHR:POS:REF:ALT format
+};
+
+#endif /* SITEFILTER_H_ */
@@ -0,0 +1,60 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned nthreads) {
+    for (unsigned i = 0; i < nthreads; i++)
+        workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(mtx);
+        terminate = true;
+    }
+    cv.notify_all();
+    for (auto& w : workers)
+        w.join();
+}
+
+void ThreadPool::parallelFor(unsigned n, const function<void(unsigned)>& f) {
+    vector<future<void>> futs;
+    futs.reserve(n);
+    for (unsigned i = 0; i < n; i++)
+        futs.push_back(submit([&f, i]() { f(i); }));
+    for (auto& fut : futs)
+        fut.get();
+}
+
+void ThreadPool::work() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this]() { return terminate || !tasks.empty(); });
+            if (tasks.empty()) // terminate and nothing left to do
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
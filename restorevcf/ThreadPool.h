@@ -0,0 +1,75 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Simple pool of persistent worker threads processing a common task queue.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned nthreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** Number of worker threads */
+    unsigned size() const { return workers.size(); }
+
+    /** Adds a task to the queue. The returned future is ready when the task has finished. */
+    template<typename F>
+    future<void> submit(F&& f) {
+        auto task = make_shared<packaged_task<void()>>(std::forward<F>(f));
+        future<void> ret = task->get_future();
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.emplace_back([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return ret;
+    }
+
+    /** Runs f(i) for i = 0..n-1 on the workers and waits until all have finished. */
+    void parallelFor(unsigned n, const function<void(unsigned)>& f);
+
+private:
+    void work();
+
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex mtx;
+    condition_variable cv;
+    bool terminate = false;
+};
+
+#endif /* THREADPOOL_H_ */
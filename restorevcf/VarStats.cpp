@@ -0,0 +1,212 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "VarStats.h"
+
+SampleGroups::SampleGroups(const string& filename) {
+    ifstream in(filename);
+    if (!in) {
+        cerr << "ERROR: Unable to open file " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    unordered_map<string, size_t> groupidxs;
+    string l;
+    while (getline(in, l)) {
+        if (l.empty() || l[0] == '#')
+            continue;
+        istringstream ls(l);
+        string sample, group;
+        if (!(ls >> sample))
+            continue; // empty line
+        if (!(ls >> group)) {
+            cerr << "ERROR: Missing group for sample " << sample << " in " << filename << endl;
+            exit(EXIT_FAILURE);
+        }
+        for (char c : group) {
+            if (!isalnum((unsigned char) c) && c != '_' && c != '.') {
+                cerr << "ERROR: Invalid group name \"" << group << "\" in " << filename << ". Only letters, digits, '_' and '.' are allowed." << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        auto it = groupidxs.emplace(group, names.size());
+        if (it.second)
+            names.push_back(group);
+        entries.emplace_back(sample, it.first->second);
+    }
+}
+
+size_t SampleGroups::assign(const unordered_map<string, size_t>* sampleidxs) {
+    size_t nunknown = 0;
+    groups.clear();
+    for (const auto& e : entries) {
+        size_t idx = 0;
+        bool found = false;
+        if (sampleidxs) {
+            auto it = sampleidxs->find(e.first);
+            found = it != sampleidxs->end();
+            if (found)
+                idx = it->second;
+        }
+        if (!found) { // no such ID, but may be an index
+            char* end;
+            idx = strtoul(e.first.c_str(), &end, 10);
+            if (e.first.empty() || !isdigit((unsigned char) e.first[0]) || *end != '\0') {
+                nunknown++;
+                continue;
+            }
+        }
+        if (idx >= groups.size())
+            groups.resize(idx+1, GROUP_NONE);
+        groups[idx] = e.second;
+    }
+    return nunknown;
+}
+
+void SampleGroups::compact(const vector<bool>& keep) {
+    size_t w = 0;
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (i >= keep.size() || keep[i])
+            groups[w++] = groups[i];
+    }
+    groups.resize(w);
+}
+
+void VarStats::reset(size_t nalt_) {
+    nalt = nalt_;
+    nsamples = 0;
+    ngtmiss = 0;
+    ndiploid = 0;
+    nhom.assign(nalt, 0);
+    nhet.assign(nalt, 0);
+    ac.assign(nalt, 0);
+    groupac.assign(ngroups * nalt, 0);
+    groupan.assign(ngroups, 0);
+}
+
+double VarStats::hwe(size_t allele) const {
+    size_t hom = nhom[allele];
+    size_t het = nhet[allele];
+    return hweExactP(het, hom, ndiploid - hom - het);
+}
+
+void scanStats(VarStats& st, const char* gt, const char* gtend, size_t idx0) {
+    const uint32_t* groups = st.groups ? st.groups->data() : NULL;
+    size_t ngroupidx = st.groups ? st.groups->size() : 0;
+    size_t idx = idx0;
+    while (gt < gtend && *gt != '\n' && *gt != '\0') {
+        // alleles of the GT field
+        size_t a0 = 0, a1 = 0; // first two alleles
+        size_t nall = 0;
+        bool miss = false;
+        uint32_t g = idx < ngroupidx ? groups[idx] : GROUP_NONE;
+        for (; gt < gtend && *gt != '\t' && *gt != ':' && *gt != '\n' && *gt != '\0'; gt++) {
+            if (*gt == '.') {
+                miss = true;
+                nall++;
+            } else if (*gt >= '0' && *gt <= '9') {
+                size_t a = *gt - '0';
+                while (gt+1 < gtend && gt[1] >= '0' && gt[1] <= '9') // continue digit by digit
+                    a = a * 10 + (*++gt - '0');
+                if (nall == 0)
+                    a0 = a;
+                else if (nall == 1)
+                    a1 = a;
+                nall++;
+                if (a && a <= st.nalt)
+                    st.ac[a-1]++;
+                if (g != GROUP_NONE) {
+                    st.groupan[g]++;
+                    if (a && a <= st.nalt)
+                        st.groupac[g * st.nalt + a-1]++;
+                }
+            }
+        }
+        st.nsamples++;
+        if (miss)
+            st.ngtmiss++;
+        else if (nall == 2) { // diploid genotype classes
+            st.ndiploid++;
+            if (a0 == a1) {
+                if (a0 && a0 <= st.nalt)
+                    st.nhom[a0-1]++;
+            } else {
+                if (a0 && a0 <= st.nalt)
+                    st.nhet[a0-1]++;
+                if (a1 && a1 <= st.nalt)
+                    st.nhet[a1-1]++;
+            }
+        }
+        // skip further fields and the tab
+        while (gt < gtend && *gt != '\t' && *gt != '\n' && *gt != '\0')
+            gt++;
+        if (gt < gtend && *gt == '\t') {
+            gt++;
+            idx++;
+        }
+    }
+}
+
+double hweExactP(size_t nhet, size_t nhom1, size_t nhom2) {
+    size_t ngt = nhet + nhom1 + nhom2;
+    if (ngt == 0)
+        return 1.0;
+    size_t rare = 2 * min(nhom1, nhom2) + nhet; // copies of the rare allele
+
+    // probabilities of all possible numbers of heterozygotes (same parity as rare), relative to the most likely one
+    vector<double> probs(rare + 1, 0.0);
+    size_t mid = (size_t) ((double) rare * (2 * ngt - rare) / (2 * ngt));
+    if ((mid & 1) != (rare & 1))
+        mid++;
+    probs[mid] = 1.0;
+    double sum = 1.0;
+
+    size_t curhomr = (rare - mid) / 2;
+    size_t curhomc = ngt - mid - curhomr;
+    for (size_t h = mid; h > 1; h -= 2) {
+        probs[h-2] = probs[h] * h * (h - 1.0) / (4.0 * (curhomr + 1.0) * (curhomc + 1.0));
+        sum += probs[h-2];
+        curhomr++;
+        curhomc++;
+    }
+
+    curhomr = (rare - mid) / 2;
+    curhomc = ngt - mid - curhomr;
+    for (size_t h = mid; h + 2 <= rare; h += 2) {
+        probs[h+2] = probs[h] * 4.0 * curhomr * curhomc / ((h + 2.0) * (h + 1.0));
+        sum += probs[h+2];
+        curhomr--;
+        curhomc--;
+    }
+
+    // p-value: sum of the probabilities of all configurations at most as likely as the observed one
+    double pobs = probs[nhet];
+    double p = 0;
+    for (size_t h = rare & 1; h <= rare; h += 2) {
+        if (probs[h] <= pobs * (1 + 1e-8))
+            p += probs[h];
+    }
+    return min(1.0, p / sum);
+}
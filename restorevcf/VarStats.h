@@ -0,0 +1,112 @@
+/*
+ *    Copyright (C) 2024 by Lars Wienbrandt,
+ *    Institute of Clinical Molecular Biology, Kiel University
+ *
+ *    This file is part of Vcffilter.
+ *
+ *    Vcffilter is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Vcffilter is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Vcffilter. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VARSTATS_H_
+#define VARSTATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+// group index of samples that are not contained in any group
+#define GROUP_NONE ((uint32_t)-1)
+
+/**
+ * Sample groups (e.g. populations) for stratified allele counts.
+ * The groups are read from a file with one sample per line: SAMPLE GROUP (separated by whitespace),
+ * lines starting with '#' are comments. Group names are used in INFO keys (AC_GROUP, AN_GROUP),
+ * so they may only contain letters, digits, '_' and '.'.
+ */
+class SampleGroups {
+public:
+    /** Reads the groups file. Exits with an error message if the file cannot be read or is invalid. */
+    explicit SampleGroups(const string& filename);
+
+    /**
+     * Assigns the groups to the sample indices (see groups). The samples in the file are given by their IDs
+     * which are mapped to the indices by sampleidxs, or by their indices (starting with 0), if sampleidxs is NULL
+     * or does not contain the ID.
+     * Returns the number of samples in the file that could not be assigned.
+     */
+    size_t assign(const unordered_map<string, size_t>* sampleidxs);
+
+    /**
+     * Removes the samples that are not kept in the output from the sample index table,
+     * so the indices refer to the remaining samples. keep contains the flag for each sample index,
+     * samples beyond the table are kept.
+     */
+    void compact(const vector<bool>& keep);
+
+    vector<string> names;    /**< group names in the order of first appearance in the file */
+    vector<uint32_t> groups; /**< group index of each sample index (GROUP_NONE if not contained in a group) */
+
+private:
+    vector<pair<string, size_t>> entries; // sample and group index from the file
+};
+
+/**
+ * Extended statistics of a variant from the genotypes: genotype classes of diploid genotypes
+ * for the Hardy-Weinberg test, missing genotypes and allele counts for each sample group.
+ */
+struct VarStats {
+    // input
+    size_t nalt = 0;                 /**< number of alternative alleles */
+    const vector<uint32_t>* groups = NULL; /**< group of each sample index, or NULL (samples beyond the table have no group) */
+    size_t ngroups = 0;
+
+    // results
+    size_t nsamples = 0;     /**< number of genotypes */
+    size_t ngtmiss = 0;      /**< genotypes with at least one missing allele */
+    size_t ndiploid = 0;     /**< diploid genotypes without missing alleles */
+    vector<size_t> nhom;     /**< for each alt allele: diploid genotypes homozygous for this allele */
+    vector<size_t> nhet;     /**< for each alt allele: diploid genotypes with exactly one copy of this allele */
+    vector<size_t> ac;       /**< for each alt allele: allele count */
+    vector<size_t> groupac;  /**< for each group the allele count of each alt allele (group * nalt + allele) */
+    vector<size_t> groupan;  /**< for each group the allele number */
+
+    /** Resets the counters for a variant with the given number of alternative alleles. */
+    void reset(size_t nalt_);
+
+    /** Fraction of missing genotypes. */
+    double fmissing() const { return nsamples ? ngtmiss / (double) nsamples : 0; }
+
+    /** Hardy-Weinberg exact test p-value of the given alt allele vs. all other alleles (diploid genotypes only). */
+    double hwe(size_t allele) const;
+};
+
+/**
+ * Counts the extended statistics of the genotypes in [gt,gtend) in st (which has to be reset before).
+ * The samples are separated by tabs, the genotype ends at the first ':' (further fields are skipped)
+ * and the genotypes end at gtend or at a newline or null character.
+ * @param idx0 sample index of the first genotype (for the groups)
+ */
+void scanStats(VarStats& st, const char* gt, const char* gtend, size_t idx0 = 0);
+
+/**
+ * Exact test for Hardy-Weinberg equilibrium (Wigginton et al., Am J Hum Genet 2005)
+ * for the given genotype counts. Returns 1 if there are no genotypes.
+ */
+double hweExactP(size_t nhet, size_t nhom1, size_t nhom2);
+
+#endif /* VARSTATS_H_ */
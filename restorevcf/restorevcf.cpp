@@ -21,56 +21,364 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <unordered_map>
 
 #include "RestoreArgs.h"
+#include "GTScan.h"
+#include "Restorer.h"
+#include "ThreadPool.h"
+#include "PloidyMap.h"
+#include "SiteFilter.h"
+#include "RestoreHeader.h"
+#include "Bcf.h"
+#include "RestoreOutput.h"
+#include "ExtractionReader.h"
+#include "VarStats.h"
 
 // large buffer
 #define BUFSIZE 1073741824
+// output is written when the buffer exceeds this size
+#define OUTBUFSIZE 1048576
+// size of a batch of lines for record-parallel processing
+#ifndef BATCHSIZE
+#define BATCHSIZE 4194304
+#endif
+// the output of an input file is spilled to a temporary file when it exceeds this size while waiting to be written
+#ifndef SPILLSIZE
+#define SPILLSIZE 67108864
+#endif
 
 using namespace std;
 
-char* findInfoField(char* info, const char* query) {
-    char* ret = NULL;
-    do {
-        ret = strstr(info, query);
-        if (ret != NULL && (ret == info || *(ret-1) == ';'))
-            return ret;
-    } while(ret != NULL);
-    return NULL;
+// a batch of complete lines and the restored output
+struct Batch {
+    vector<char> data;      // all lines, each null terminated
+    vector<size_t> offsets; // beginning of each line in data
+    vector<size_t> lens;    // length of each line (without null terminator)
+    vector<string> outs;    // output for each profile
+};
+
+// an input extraction with its header and its first data line
+struct Input {
+    ExtractionReader* reader = NULL;
+    bool empty = true;      // does not even contain the chromosome line
+    string chrom;
+    bool parsegq = false;   // the extraction contains GQ fields
+    vector<string> hdr;     // embedded VCF header
+    char* line = NULL;      // line buffer holding the first data line after reading the header
+    size_t len = 0;
+    ssize_t nline = -1;     // length of the first data line, -1 if there is none
+};
+
+// writes the outputs of all profiles
+static void writeOuts(vector<string>& outs, const vector<RestoreOutput*>& outputs) {
+    for (size_t p = 0; p < outs.size(); p++) {
+        outputs[p]->write(outs[p].data(), outs[p].size());
+        outs[p].clear();
+    }
+}
+
+// reads the header of an extraction: the chromosome name followed by the args of vcffilter,
+// and the embedded VCF header (if present). The first data line is left in the line buffer.
+static void readExtractionHeader(Input& in) {
+    char*& line = in.line;
+    ssize_t nh = in.reader->getline(&line, &in.len); // read header line
+    if (nh <= 0)
+        return;
+    in.empty = false;
+
+    // overwrite newline character at the end of the line (prevents correct parsing below)
+    *(line+nh-1) = '\0';
+
+    // search for more args (separated by ';' as written by vcffilter, or by tab)
+    char* chrend = strpbrk(line, ";\t");
+    // null terminate chromosome name
+    if (chrend != NULL) {
+        *chrend = '\0';
+    }
+    in.chrom = line; // copy chromosome name
+
+    // parse more args
+    char* arg = (chrend != NULL) ? chrend+1 : NULL;
+    while (arg != NULL) {
+        char* argend = strchr(arg, ';'); // separator for the args in the header is the semicolon char
+        if (argend != NULL) {
+            *argend = '\0';
+        }
+        if (strcmp(arg, "--gq") == 0) // --gq option was set -> restore GQ field
+            in.parsegq = true;
+        arg = (argend != NULL) ? argend+1 : NULL;
+    }
+
+    // VCF header embedded by vcffilter (all lines start with '#')
+    ssize_t nline = in.reader->getline(&line, &in.len);
+    for (; nline != -1 && *line == '#'; nline = in.reader->getline(&line, &in.len)) {
+        size_t n = nline;
+        while (n && (line[n-1] == '\n' || line[n-1] == '\r'))
+            n--;
+        in.hdr.push_back(string(line, n));
+    }
+    in.nline = nline;
+}
+
+// sample IDs of an input from the #CHROM line of the embedded header (tab separated), returns false if there is no #CHROM line
+static bool headerSamples(const Input& in, string& samples) {
+    if (in.hdr.empty() || in.hdr.back().compare(0, 6, "#CHROM") != 0)
+        return false;
+    const string& l = in.hdr.back();
+    size_t pos = 0;
+    for (int t = 0; t < 9 && pos != string::npos; t++) // samples start in the 10th column
+        pos = l.find('\t', pos + (t ? 1 : 0));
+    samples = pos == string::npos ? string() : l.substr(pos + 1);
+    if (!samples.empty() && samples.back() == '\r')
+        samples.pop_back();
+    return true;
+}
+
+// number of samples of an input from the #CHROM line of the embedded header or from the first data line, -1 if unknown
+static ssize_t numSamples(const Input& in) {
+    string samples;
+    if (headerSamples(in, samples))
+        return samples.empty() ? 0 : count(samples.begin(), samples.end(), '\t') + 1;
+    if (in.nline != -1) { // POS ... INFO are followed by the genotypes
+        size_t ntabs = count(in.line, in.line + in.nline, '\t');
+        return ntabs > 6 ? ntabs - 6 : 0;
+    }
+    return -1;
+}
+
+// all inputs are written as one output with the header of the first input, so they have to contain the same samples:
+// the sample IDs are compared if the headers are present, otherwise the number of samples. Exits with an error otherwise.
+static void checkSamples(const vector<Input>& files, const vector<string>& inputs) {
+    size_t ref = 0;
+    while (ref < files.size() && files[ref].empty)
+        ref++;
+    string refsamples;
+    bool refhdr = ref < files.size() && headerSamples(files[ref], refsamples);
+    ssize_t refn = ref < files.size() ? numSamples(files[ref]) : -1;
+    for (size_t i = ref + 1; i < files.size(); i++) {
+        if (files[i].empty)
+            continue;
+        string samples;
+        if (refhdr && headerSamples(files[i], samples)) {
+            if (samples != refsamples) {
+                cerr << "ERROR: Input files contain different samples: " << inputs[ref] << " and " << inputs[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            ssize_t n = numSamples(files[i]);
+            if (refn != -1 && n != -1 && n != refn) {
+                cerr << "ERROR: Input files contain different numbers of samples: " << refn << " (" << inputs[ref] << ") and " << n << " (" << inputs[i] << ")" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+// restored output of an input file for all profiles, which is kept until the outputs of all previous files are written.
+// Large outputs are spilled to a temporary file.
+struct FileResult {
+    deque<vector<string>> chunks;
+    size_t memsize = 0;
+    FILE* spill = NULL;
+    vector<RestoreCounters> counters;
+
+    // takes over the outputs (which are cleared)
+    void add(vector<string>& outs) {
+        chunks.emplace_back(outs.size());
+        for (size_t p = 0; p < outs.size(); p++) {
+            memsize += outs[p].size();
+            chunks.back()[p].swap(outs[p]);
+        }
+        if (memsize < SPILLSIZE)
+            return;
+        if (spill == NULL && (spill = tmpfile()) == NULL) {
+            cerr << "ERROR: Unable to create a temporary file." << endl;
+            exit(EXIT_FAILURE);
+        }
+        for (const vector<string>& c : chunks) {
+            for (const string& o : c) {
+                uint64_t n = o.size();
+                fwrite(&n, sizeof(n), 1, spill);
+                fwrite(o.data(), 1, n, spill);
+            }
+        }
+        chunks.clear();
+        memsize = 0;
+    }
+
+    // writes the spilled outputs followed by those still held in memory
+    void writeTo(const vector<RestoreOutput*>& outputs) {
+        if (spill) {
+            rewind(spill);
+            vector<string> outs(outputs.size());
+            for (;;) {
+                size_t p = 0;
+                for (; p < outs.size(); p++) {
+                    uint64_t n;
+                    if (fread(&n, sizeof(n), 1, spill) != 1)
+                        break;
+                    outs[p].resize(n);
+                    if (fread(&outs[p][0], 1, n, spill) != n)
+                        break;
+                }
+                if (p < outs.size()) {
+                    if (p > 0 || !feof(spill)) {
+                        cerr << "ERROR: Failed reading the temporary file." << endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                }
+                writeOuts(outs, outputs);
+            }
+            fclose(spill);
+            spill = NULL;
+        }
+        for (vector<string>& c : chunks)
+            writeOuts(c, outputs);
+        chunks.clear();
+        memsize = 0;
+    }
+};
+
+// prints the filter options of a profile
+static void printProfileArgs(const RestoreProfile& p, const string& indent) {
+    cerr << indent << "fpass:         " << p.fpass << endl;
+    cerr << indent << "rminfo:        " << p.rminfo << endl;
+    cerr << indent << "keepaa:        " << p.keepaa << endl;
+    cerr << indent << "macfilter:     " << p.macfilter << endl;
+    cerr << indent << "maffilter:     " << p.maffilter << endl;
+    cerr << indent << "aafilter:      " << p.aafilter << endl;
+    cerr << indent << "missfilter:    " << p.missfilter << endl;
+    cerr << indent << "filterunknown: " << p.filterunk << endl;
+    cerr << indent << "splitma:       " << p.splitma << endl;
+    cerr << indent << "stats:         " << p.stats << endl;
+    cerr << indent << "hwefilter:     " << p.hwefilter << endl;
+    cerr << indent << "sites-only:    " << p.sitesonly << endl;
 }
 
-int ptrcmp (const void* a, const void* b) {
-    return ( *(char**)a - *(char**)b );
+// prints the counters of a profile
+static void printCounters(const RestoreCounters& c) {
+    cerr << "Number of read variants: " << c.nread << endl;
+    cerr << "Number of printed variants: " << c.nprint << endl;
+    cerr << "Number of splitted variants: " << c.nsplit << endl;
+    cerr << "Number of skipped variants (after split): " << c.nskip << endl;
+    if (c.nsiteskip)
+        cerr << "Number of variants skipped due to the site list: " << c.nsiteskip << endl;
+    if (c.nundefined)
+        cerr << "WARNING: INFO fields or filters not defined in the header were dropped from the BCF records: " << c.nundefined << endl;
 }
 
-// deletes all characters from gt backwards until the hap separator '/' or '|' (inclusive)
-// by setting them to '\0'.
-// returns position of last deleted char
-char* delete2ndhap(char* gt) {
-    char* tmp = gt;
-    for (; *tmp != '/' && *tmp != '|'; tmp--) {
-        *tmp = '\0';
+// Record-parallel restoration: the lines from stdin (starting with the already read line) are collected in batches,
+// which are processed concurrently by the pool's workers. Each worker uses one of the provided restorers exclusively.
+// The outputs are written to the output files of the profiles in input order.
+void restoreBatches(ExtractionReader& in, char*& line, ssize_t nline, size_t& len, vector<Restorer*>& restorers, const vector<RestoreOutput*>& outputs, ThreadPool& pool) {
+
+    vector<Restorer*> freerestorers(restorers);
+    mutex rmtx;
+    deque<pair<shared_ptr<Batch>, future<void>>> inflight;
+    vector<shared_ptr<Batch>> freebatches;
+    const size_t maxinflight = 2 * pool.size();
+
+    // writes the oldest batch
+    auto writeFront = [&]() {
+        inflight.front().second.get();
+        shared_ptr<Batch> b = inflight.front().first;
+        inflight.pop_front();
+        writeOuts(b->outs, outputs);
+        freebatches.push_back(b);
+    };
+
+    // processes a batch on the pool
+    auto submit = [&](shared_ptr<Batch> b) {
+        future<void> f = pool.submit([b, &freerestorers, &rmtx]() {
+            Restorer* r;
+            {
+                lock_guard<mutex> lock(rmtx);
+                r = freerestorers.back();
+                freerestorers.pop_back();
+            }
+            for (size_t i = 0; i < b->offsets.size(); i++)
+                r->processLine(b->data.data() + b->offsets[i], b->lens[i], b->outs.data());
+            {
+                lock_guard<mutex> lock(rmtx);
+                freerestorers.push_back(r);
+            }
+        });
+        inflight.emplace_back(b, std::move(f));
+    };
+
+    shared_ptr<Batch> batch;
+    for (; nline != -1; nline = in.getline(&line, &len)) {
+        if (!batch) {
+            if (!freebatches.empty()) {
+                batch = freebatches.back();
+                freebatches.pop_back();
+            } else {
+                batch = make_shared<Batch>();
+                batch->outs.resize(outputs.size());
+            }
+            batch->data.clear();
+            batch->offsets.clear();
+            batch->lens.clear();
+        }
+        batch->offsets.push_back(batch->data.size());
+        batch->lens.push_back(nline);
+        batch->data.insert(batch->data.end(), line, line + nline + 1); // including null terminator
+        if (batch->data.size() >= BATCHSIZE) {
+            if (inflight.size() >= maxinflight)
+                writeFront();
+            submit(batch);
+            batch.reset();
+        }
     }
-    *tmp = '\0'; // delete separator '/' or '|'
-    return tmp;
+    if (batch)
+        submit(batch);
+    while (!inflight.empty())
+        writeFront();
 }
 
-// starts deleting the haplotype first by iterating backwards starting from "gt"
-// and setting the chars to '\0'.
-// when the end of a genotype is found the '.' is set at the last field which was deleted before
-// a sequence of '\0' is ignored when detected in the beginning (so, the first chars to test)
-// the end of a gt field is determined by a change from a digit char to something else
-void setmissinghap(char* gt) {
-    char* tmp = gt;
-    while (*tmp == '\0') tmp--;
-    for (; *tmp >= '0' && *tmp <= '9'; tmp--) { // reverse until beginning of GT field
-        *tmp = '\0';
+// File-parallel restoration: each input file is restored line by line by a task with its own restorer
+// (with the header args of the file, e.g. --gq). The outputs are written in the order of the files.
+static void restoreFiles(vector<Input>& files, const vector<RestoreProfile>& profiles, const string& chrom, const PloidyMap& ploidymap,
+        const SiteFilter* sitefilter, const vector<const BcfHeader*>& bcfheaders, const SampleGroups* groups, const vector<RestoreOutput*>& outputs, unsigned nthreads,
+        vector<RestoreCounters>& counters) {
+
+    ThreadPool filepool(min((size_t) nthreads, files.size()));
+    vector<FileResult> results(files.size());
+    vector<future<void>> futures;
+    for (size_t i = 0; i < files.size(); i++) {
+        futures.push_back(filepool.submit([&, i]() {
+            Input& f = files[i];
+            FileResult& res = results[i];
+            Restorer r(profiles, chrom, f.parsegq, ploidymap, sitefilter, bcfheaders, groups);
+            vector<string> outs(profiles.size());
+            for (; f.nline != -1; f.nline = f.reader->getline(&f.line, &f.len)) {
+                r.processLine(f.line, f.nline, outs.data());
+                size_t outsize = 0;
+                for (const string& o : outs)
+                    outsize += o.size();
+                if (outsize >= OUTBUFSIZE)
+                    res.add(outs);
+            }
+            res.add(outs);
+            res.counters = r.counters;
+        }));
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        futures[i].get();
+        results[i].writeTo(outputs);
+        for (size_t p = 0; p < profiles.size(); p++)
+            counters[p] += results[i].counters[p];
     }
-    *(tmp+1) = '.'; // set the missing '.' char
 }
 
 int main (int argc, char **argv) {
@@ -78,527 +386,305 @@ int main (int argc, char **argv) {
     // parse args
     RestoreArgs args = RestoreArgs::parseArgs(argc, argv);
 
-    bool fpass = args.fpass;
-    bool rminfo = args.rminfo;
-    bool keepaa = args.keepaa;
-    size_t macfilter = args.macfilter;
-    float maffilter = args.maffilter;
-    float aafilter = args.aafilter;
-    float missfilter = args.missfilter;
-    bool filterunk = args.filterunk;
-    bool splitma = args.splitma;
+    const vector<RestoreProfile>& profiles = args.profiles;
+    bool named = !args.profilestrs.empty(); // named profiles instead of filter options
     bool makehap = args.makehap;
     string hapidxfile = args.hapidxfile;
+    string ploidyfile = args.ploidyfile;
+    string excludefile = args.excludefile;
+    string includefile = args.includefile;
+    string sampleheader = args.sampleheader;
+    string includesites = args.includesites;
+    string excludesites = args.excludesites;
+    string groupsfile = args.groupsfile;
+    bool noheader = args.noheader;
+    bool csi = args.csi;
+    size_t shardvariants = args.shardvariants;
+    size_t shardbytes = args.shardbytes;
+    unsigned nthreads = args.nthreads;
+    vector<string> inputs = args.inputs;
+    if (inputs.empty())
+        inputs.push_back("-");
+    bool gq = args.gq;
+    string extractionout = args.extractionout;
 
     cerr << "Args:" << endl;
-    cerr << "  fpass:         " << fpass << endl;
-    cerr << "  rminfo:        " << rminfo << endl;
-    cerr << "  keepaa:        " << keepaa << endl;
-    cerr << "  macfilter:     " << macfilter << endl;
-    cerr << "  maffilter:     " << maffilter << endl;
-    cerr << "  aafilter:      " << aafilter << endl;
-    cerr << "  missfilter:    " << missfilter << endl;
-    cerr << "  filterunknown: " << filterunk << endl;
-    cerr << "  splitma:       " << splitma << endl;
+    cerr << "  inputs:       ";
+    for (const string& f : inputs)
+        cerr << " " << f;
+    cerr << endl;
+    for (const auto& p : profiles) {
+        if (named) {
+            cerr << "  profile:       " << p.name << " -> " << p.outfile << " (" << p.outputtype << ")" << endl;
+            printProfileArgs(p, "    ");
+        } else
+            printProfileArgs(p, "  ");
+    }
     cerr << "  makehap:       " << makehap;
     if (makehap)
         cerr << "\t" << hapidxfile;
     cerr << endl;
+    cerr << "  ploidyregions: " << ploidyfile << endl;
+    cerr << "  exclude:       " << excludefile << endl;
+    cerr << "  include:       " << includefile << endl;
+    cerr << "  sampleheader:  " << sampleheader << endl;
+    cerr << "  includesites:  " << includesites << endl;
+    cerr << "  excludesites:  " << excludesites << endl;
+    cerr << "  groups:        " << groupsfile << endl;
+    cerr << "  noheader:      " << noheader << endl;
+    if (!named) {
+        cerr << "  output:        " << profiles[0].outfile << endl;
+        cerr << "  outputtype:    " << profiles[0].outputtype << endl;
+    }
+    cerr << "  csi:           " << csi << endl;
+    cerr << "  shardvariants: " << shardvariants << endl;
+    cerr << "  shardbytes:    " << shardbytes << endl;
+    cerr << "  threads:       " << nthreads << endl;
+    cerr << "  gq:            " << gq << endl;
+    if (!extractionout.empty())
+        cerr << "  extraction:    " << extractionout << endl;
+
+    // worker threads for parallel processing of batches of lines or wide lines
+    ThreadPool* pool = nthreads > 1 ? new ThreadPool(nthreads) : NULL;
 
     size_t len = BUFSIZE;
     const size_t lenstart = len;
     char* line = (char*) malloc(len*sizeof(char));
-    size_t nread = 0;
-    size_t nprint = 0;
-    size_t nskip = 0;
-    size_t nsplit = 0;
-    vector<bool> hapidxs(524288, false); // 512*1024 -> enough for UKB
-    size_t nhapconflicts_total = 0;
+    vector<RestoreCounters> counters(profiles.size());
+    vector<unsigned char> sampleactions; // default action for each sample index, sized by the largest index in use
 
     // for converting to haploid:
     if (makehap) {
-        FILE* idxf = fopen(hapidxfile.c_str(), "r");
-        while(getline(&line, &len, idxf) != -1) {
-            hapidxs[atol(line)] = true; // mark those indices that should be made haploid
+        if (!readSampleActions(hapidxfile, SAMPLE_HAPLOID, sampleactions)) { // mark those indices that should be made haploid
+            cerr << "ERROR: Unable to open file " << hapidxfile << endl;
+            exit(EXIT_FAILURE);
         }
-        fclose(idxf);
     }
 
-    // parse header
-    size_t nh = getline(&line, &len, stdin); // read header line
-    if (nh > 0 && nh != (size_t)-1) { // contains data
-
-        // overwrite newline character at the end of the line (prevents correct parsing below)
-        *(line+nh-1) = '\0';
-
-        // search for more args (separated by tab)
-        char* chrend = strchr(line, '\t');
-        // null terminate chromosome name
-        if (chrend != NULL) {
-            *chrend = '\0';
+    // inputs: stdin or the given extraction files
+    vector<Input> files(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        Input& f = files[i];
+        f.reader = new ExtractionReader(inputs[i], gq, extractionout);
+        if (i == 0) { // the large buffer is used for the first input
+            f.line = line;
+            f.len = len;
         }
-        string chrom(line); // copy chromosome name
-
-        // parse more args
-        bool parsegq = false;
-        char* arg = (chrend != NULL) ? chrend+1 : NULL;
-        while (arg != NULL) {
-            char* argend = strchr(arg, ';'); // separator for the args in the header is the semicolon char
-            if (argend != NULL) {
-                *argend = '\0';
-            }
-            if (strcmp(arg, "--gq") == 0) // --gq option was set -> restore GQ field
-                parsegq = true;
-            arg = (argend != NULL) ? argend+1 : NULL;
+        readExtractionHeader(f);
+        if (i == 0) {
+            line = f.line;
+            len = f.len;
         }
+        if (f.reader->isVCF())
+            cerr << "Input " << inputs[i] << " is a VCF, the extraction is created in-process." << endl;
+        else if (!extractionout.empty())
+            cerr << "WARNING: Input " << inputs[i] << " is already an extraction, --write-extraction is ignored." << endl;
+        if (!f.empty && f.chrom != files[0].chrom) {
+            cerr << "ERROR: Input files contain different chromosomes: " << files[0].chrom << " (" << inputs[0] << ") and " << f.chrom << " (" << inputs[i] << ")" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    checkSamples(files, inputs);
 
-        // reserve space for allele counters
-        size_t nac = 10;
-        size_t* ac = (size_t*) malloc(nac * sizeof(size_t));
-
-        // parse rest of file
-        ssize_t nline = 0;
-        while((nline = getline(&line, &len, stdin)) != -1) {
-
-            // genomic position
-            char* pos = line;
-            char* posend = strchr(pos, '\t'); // end of genomic position (exclusive, points to tab char)
-            if (posend == NULL) // no tab char -> invalid line (can happen for the last line when it contains only a newline character, or when concatenating files the header of the new file) -> skip
-                continue;
-            nread++;
-
-            // variant ID
-            char* varid = posend+1;
-            char* varidend = strchr(varid, '\t');
-
-            // alleles
-            char* refall = varidend+1;
-            char* refallend = strchr(refall, '\t'); // end of first allele (exclusive)
-            char* altall = refallend+1;
-            char* altallend = strchr(refallend+1, '\t'); // end of alternative alleles (exclusive)
-
-            // count number of alternative alles + check if unknown + prepare split
-            size_t nalt = 0;
-            int unkidx = -1; // points to the alt allele which is unknown (-1 if none)
-            vector<char*> maaltalleles; // used to store the pointers to the alt alleles
-            *altallend = '\0'; // null terminate the allele string (to stop following loop)
-            for (char* t = refallend; t != NULL; t = strchr(t+1, ',')) { // will stop at altallend as we have null terminated the buffer there
-                // t always points to the delimiter before the current allele (also at the beginning)!
-                if (filterunk && *(t+1) == '*') { // found unknown allele
-                    unkidx = nalt;
-                }
-                if (splitma && nalt >= 1) { // we have a multi-allelic variant here which we want to split
-                    if (nalt == 1) { // second ma alt allele
-                        // need to insert the first alt allele in our vector
-                        maaltalleles.push_back(altall);
-                    }
-                    maaltalleles.push_back(t+1); // store beginning of this alternative allele
-                    *t = '\0'; // need to null terminate the delimiter for printing later
+    // parse header
+    if (!files[0].empty) { // contains data
+
+        const string& chrom = files[0].chrom;
+        bool parsegq = files[0].parsegq;
+        const vector<string>& hdr = files[0].hdr; // the header of the first file is used for the output
+        ssize_t nline = files[0].nline;
+        bool anygq = false; // GQ is described in the BCF header if any of the files contains it
+        for (const Input& f : files)
+            anygq |= f.parsegq;
+
+        // (the first data line decides about the mode of parallelization)
+
+        // sample IDs for selecting samples by ID: from --sample-header or from the #CHROM line of the embedded header
+        unordered_map<string, size_t> sampleidxs;
+        const unordered_map<string, size_t>* sampleids = NULL; // NULL if samples can be given by their indices only
+        if (!excludefile.empty() || !includefile.empty() || !groupsfile.empty()) {
+            if (!sampleheader.empty()) {
+                if (!readSampleHeader(sampleheader, sampleidxs)) {
+                    cerr << "ERROR: Unable to read sample IDs from " << sampleheader << endl;
+                    exit(EXIT_FAILURE);
                 }
-                nalt++;
+                sampleids = &sampleidxs;
+            } else if (!hdr.empty() && hdr.back().compare(0, 6, "#CHROM") == 0) {
+                parseSampleIDs(hdr.back(), sampleidxs);
+                sampleids = &sampleidxs;
             }
+        }
 
-            // filter single unknown "*" alleles
-            if (unkidx >= 0 && nalt == 1) { // filter is activated and an unknown allele was found which is the only alt allele
-                nskip++;
-                continue; // skip this line
-            } // else if there was an unknown allele together in a multi-allelic context, we filter it later
-
-            // prepare for ma splits
-            bool masplitnow = splitma && nalt > 1;
-            vector<bool> maaltfilter;
-            if (masplitnow) { // multi-allelic variant that needs to be split
-                nsplit++;
-                *refallend = '\0'; // null terminate the ref allele field as we need to separate printing of alt alleles later
-                // initialize the flags for which allele should be filtered -> default: not filtered
-                maaltfilter.assign(nalt, false);
-                if (unkidx >= 0) // if there's an unknown allele to be filtered, mark it already
-                    maaltfilter[unkidx] = true;
-            } else { // no ma splitting required
-                *altallend = '\t'; // restore tab -> faster printing later
+        // remove samples
+        if (!excludefile.empty() || !includefile.empty()) {
+            bool include = !includefile.empty();
+            const string& listfile = include ? includefile : excludefile;
+            vector<unsigned char> listed;
+            size_t nunknown = 0;
+            if (!readSampleActions(listfile, SAMPLE_DROP, listed, sampleids, &nunknown)) {
+                cerr << "ERROR: Unable to open file " << listfile << endl;
+                exit(EXIT_FAILURE);
             }
-
-            // initialize allele counters
-            // (we use directly allocated memory here as it is significantly faster than a vector!)
-            if (nalt > nac) {
-                ac = (size_t*) realloc(ac, nalt * sizeof(size_t));
-                nac = nalt;
+            if (nunknown)
+                cerr << "WARNING: " << nunknown << " samples in " << listfile << " were not found in the sample header." << endl;
+            // number of samples from the first line (POS ... INFO are followed by the genotypes)
+            size_t nsamples = 0;
+            if (nline != -1) {
+                size_t ntabs = count(line, line + nline, '\t');
+                nsamples = ntabs > 6 ? ntabs - 6 : 0;
             }
-            for (size_t i = 0; i < nalt; i++)
-                ac[i] = 0;
-            size_t an = 0;
-            size_t nhap = 0; // number of haps incl. missing -> for diploids = number of samples * 2
-
-            // qual field
-            char* qual = altallend+1; // start
-            char* qualend = strchr(qual, '\t'); // end (exclusive)
-
-            // filter field
-            char* filter = qualend+1; // start of filter field
-            char* filterend = strchr(filter, '\t'); // end of filter (exclusive)
-            *filterend = '\0'; // null terminate filter field, as we are going to modify the following INFO fields for printing
-
-            // FILTER == PASS filter
-            if (fpass) {
-                if (strcmp(filter, "PASS") != 0) { // not passed!
-                    nskip += masplitnow ? nalt : 1;
-                    continue; // skip this line
+            if (sampleactions.size() < max(nsamples, listed.size()))
+                sampleactions.resize(max(nsamples, listed.size()), SAMPLE_KEEP);
+            size_t ndropped = 0;
+            for (size_t i = 0; i < sampleactions.size(); i++) {
+                bool islisted = i < listed.size() && listed[i] == SAMPLE_DROP;
+                if (islisted != include) {
+                    sampleactions[i] = SAMPLE_DROP;
+                    if (i < nsamples)
+                        ndropped++;
                 }
             }
+            cerr << "Removed samples: " << ndropped << " of " << nsamples << endl;
+        }
 
-            // info
-            char* info = filterend+1; // start
-            char* infoend = strchr(info, '\t'); // end
-            *infoend = '\0'; // null terminate INFO field
-
-            // AAScore filter
-            char* aa = NULL; // will be beginning of AAScore field, if we filter by AAScore or keep AAScores while removing the rest of INFO (as for split MA's)
-            vector<char*> aaval; // pointers to the AAScore values
-            if (aafilter > 0 || keepaa) {
-                bool pass = !(aafilter > 0); // only required as false if we want to filter by AAScore
-                aa = findInfoField(info, "AAScore=");
-                char* aatmp = aa+8; // beginning of first value
-
-                // iterate over all alt alleles
-                for (size_t n = 0; n < nalt; n++) {
-                    char* aaend;
-                    if (n < nalt-1) { // more than one alt allele
-                        aaend = strchr(aatmp, ','); // will be found in a proper VCF
-                    } else { // last alt allele
-                        aaend = strchr(aatmp, ';'); // end of AAScore field or null if at the end of INFO
-                        if (aaend == NULL)
-                            aaend = infoend;
-                    }
-                    if (keepaa){
-                        aaval.push_back(aatmp);
-                        *aaend = '\0'; // null terminate for printing separately
-                    }
-                    float aav = stof(string(aatmp, aaend - aatmp));
-                    if (aav >= aafilter) { // value above threshold
-                        pass = true;
-                        if (!keepaa && !masplitnow) // if we do not keepaa explicitly and if we do not split MA's, we can stop here
-                            break;
-                    } else if (masplitnow && aafilter > 0) { // value below threshold and we are splitting MA here and a filter is active
-                        // mark this allele to be filtered later
-                        maaltfilter[n] = true;
-                    }
-                    aatmp = aaend + 1; // beginning of next value
-                }
-                if (!pass) { // all AAScores are below the threshold
-                    nskip += masplitnow ? nalt : 1;
-                    continue; // skip this line
-                }
-            }
+        // per-sample actions for each position range
+        PloidyMap ploidymap(sampleactions);
+        if (!ploidyfile.empty()) {
+            ploidymap.loadRegions(ploidyfile, chrom);
+            cerr << "Ploidy regions for " << chrom << ": " << ploidymap.nregions << endl;
+        }
 
-            // genotypes
-            char* gtstart = infoend+1; // start of genotypes (pointing at first gt char!)
-            vector<char*> magts; // for MA splits, the beginning of the genotypes
-            vector<vector<char*>> gtparts;  // for MA splits and large allele indices or conversion to hap, we need to replace characters. we replace them with '\0' with this vector pointing to all replaced positions plus one (so the next part to print)
-            if (masplitnow) {
-                // copy gts for the multi-allelic splits (including null terminator!)
-                size_t gtsize = (line + nline) - gtstart + 1;
-                magts.resize(nalt, NULL); // reserve for all alt alleles
-                magts[0] = gtstart; // for the first alternative allele, we keep the line buffer
-                for (size_t a = 1; a < nalt; a++) { // for all other alt alleles, we reserve space and copy the gts, if we do not filter them anyway
-                    if (!maaltfilter[a]) {
-                        magts[a] = (char*) malloc(gtsize * sizeof(char));
-                        memcpy(magts[a], gtstart, gtsize * sizeof(char));
-                    }
-                }
-            }
-            if (makehap)
-                gtparts.resize(masplitnow ? nalt : 1); // we need at least one parts vector if we convert to haploid
-            else if (masplitnow && nalt >= 10) { // if we split and need to delete chars due to allele indices with more than one digit
-                gtparts.resize(nalt); // we need one for each alt allele!
-            }
-            bool gtflag = true; // signalizes if the current field contains genotypes or not
-            size_t gtidx = 0; // current genotype (sample) idx
-            size_t hap = 0; // store last hap -> to check if conversion to haploid is ok
-            bool hapflag = false; // indicator flag for diploids: false = first, true = second
-            size_t ngtmiss = 0; // missing alleles counter
-            size_t nhapconflicts = 0;
-            for (char* gt = gtstart; *gt != '\0'; gt++) { // until the end of the line buffer
-
-                if (gtflag && *gt >= '0' && *gt <= '9') { // points to valid haplotype
-                    if (!hapflag || !hapidxs[gtidx]) { // hapflag is always false if !makehap
-                        an++; // increase allele number only if it's the first haplotype or if we are not converting this gt to haploid
-                        nhap++;
-                    }
-                    size_t idx = *gt - '0';
-                    if (*gt >= '1') {
-                        size_t gtpos = gt - gtstart;
-                        while (*(gt+1) >= '0' && *(gt+1) <= '9') { // continue digit by digit
-                            gt++;
-                            idx = idx * 10 + (*gt - '0');
-                            if (masplitnow) {
-                                // allele index is >= 10, so we need to delete all digits after the first (replace with \0, but we store the following position for printing later)
-                                // we take care of the first digit later
-                                *gt = '\0';
-                                gtparts[0].push_back(gt+1);
-                                size_t pos = gt - gtstart;
-                                for (size_t a = 1; a < nalt; a++) {
-                                    if (!maaltfilter[a]) {
-                                        *(magts[a]+pos) = '\0';
-                                        gtparts[a].push_back(magts[a]+pos+1);
-                                    }
-                                }
-                            }
-                        }
-                        if (!hapflag || !hapidxs[gtidx]) {
-                            ac[idx-1]++; // increase corresponding alt allele counter only if ... see allele number
-                        }
-                        if (masplitnow) {
-                            // set current allele to '1' and all others to '0'
-                            for (size_t a = 0; a < nalt; a++) {
-                                if (!maaltfilter[a]) {
-                                    if (a == idx-1)
-                                        *(magts[a]+gtpos) = '1';
-                                    else
-                                        *(magts[a]+gtpos) = '0';
-                                }
-                            }
-                        }
-                    }
-                    if (makehap && hapidxs[gtidx]) { // convert this genotype to haploid
-                        if (!hapflag) { // first: store current hap for a check
-                            hap = idx;
-                        } else { // second -> delete
-                            bool setmissing = false;
-                            if (hap != idx) { // check if this equals the first, otherwise: conflict and set missing
-                                nhapconflicts++;
-                                // correct counters
-                                an--;
-                                if (hap) ac[hap-1]--;
-                                // set missing
-                                ngtmiss++;
-                                setmissing = true;
-                            }
-                            // delete second hap
-                            // store following position for printing (if not already done by splitting an MA)
-                            if (gtparts[0].empty() || gtparts[0].back() != gt+1) // never insert twice!
-                                gtparts[0].push_back(gt+1);
-                            char* tmp = delete2ndhap(gt); // returns position to last deleted char
-                            if (setmissing) {
-                                setmissinghap(tmp-1);
-                            }
-                            if (masplitnow) { // also for split MA's
-                                size_t pos = gt - gtstart;
-                                for (size_t a = 1; a < nalt; a++) {
-                                    if (!maaltfilter[a]) {
-//                                        if (*gt != '\0')
-                                        if (gtparts[a].empty() || gtparts[a].back() != magts[a]+pos+1) // never insert twice!
-                                            gtparts[a].push_back(magts[a]+pos+1);
-                                        tmp = delete2ndhap(magts[a]+pos);
-                                        if (setmissing) {
-                                            setmissinghap(tmp-1);
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                } else if (gtflag && *gt == '.') { // missing gt
-                    if (!hapflag || !hapidxs[gtidx]) {
-                        ngtmiss++;
-                        nhap++; // also count missings here
-                    } else {
-                        // need to delete "/." due to conversion to haploid
-                        gtparts[0].push_back(gt+1);
-                        delete2ndhap(gt);
-                        if (masplitnow) { // also for split MA's
-                            size_t pos = gt - gtstart;
-                            for (size_t a = 1; a < nalt; a++) {
-                                if (!maaltfilter[a]) {
-                                    gtparts[a].push_back(magts[a]+pos+1);
-                                    delete2ndhap(magts[a]+pos);
-                                }
-                            }
-                        }
-                    }
-                } else if (*gt == ':') { // double colon marks the end of a genotype
-                    gtflag = 0;
-                } else if (*gt == '\t') { // tab marks the end of a gt field
-                    gtflag = 1;
-                    hapflag = false;
-                    gtidx++;
-                } else if (makehap && (*gt == '/' || *gt == '|') ) { // second hap (only mark if we want to convert to haploid)
-                    hapflag = true;
-                }
+        // sample groups for stratified allele counts (indices of the samples in the output)
+        SampleGroups* groups = NULL;
+        if (!groupsfile.empty()) {
+            groups = new SampleGroups(groupsfile);
+            size_t nunknown = groups->assign(sampleids);
+            if (nunknown)
+                cerr << "WARNING: " << nunknown << " samples in " << groupsfile << " were not found in the sample header." << endl;
+            vector<bool> keep(sampleactions.size());
+            for (size_t i = 0; i < sampleactions.size(); i++)
+                keep[i] = sampleactions[i] != SAMPLE_DROP;
+            groups->compact(keep);
+            cerr << "Sample groups: " << groups->names.size() << endl;
+        }
 
-            }
+        // site list
+        SiteFilter* sitefilter = NULL;
+        if (!includesites.empty() || !excludesites.empty()) {
+            sitefilter = new SiteFilter(includesites.empty() ? excludesites : includesites, !includesites.empty());
+            cerr << "Sites in list: " << sitefilter->size() << endl;
+        }
 
-            // GT missingness filter
-            if (missfilter > 0) {
-                if (ngtmiss / (float) nhap >= missfilter) {
-                    // skip this line
-                    if (!masplitnow) {
-                        nskip++;
-                        continue;
-                    } else // need to continue here for a proper cleanup and we set all filters to '1'
-                        maaltfilter.assign(nalt, true);
-                }
+        // outputs with the VCF header
+        vector<const BcfHeader*> bcfheaders(profiles.size(), NULL);
+        vector<RestoreOutput*> outputs;
+        string command;
+        for (int i = 0; i < argc; i++) {
+            command.append(argv[i]);
+            command.push_back(' ');
+        }
+        for (size_t p = 0; p < profiles.size(); p++) {
+            string h;
+            int32_t tid = 0;
+            if (profiles[p].outputtype == 'b' && hdr.empty()) {
+                cerr << "ERROR: BCF output requires the VCF header, which is not contained in the extraction." << endl;
+                exit(EXIT_FAILURE);
             }
-
-            // MAC/MAF filter
-            if (macfilter || maffilter > 0) {
-                bool pass = false;
-                size_t mac = 0;
-                size_t minmac = macfilter;
-                if (maffilter > 0) { // set min MAC according to MAF filter
-                    minmac = (size_t) ceil(maffilter * an);
-                }
-                // iterate over all alt alleles
-                for (size_t n = 0; n < nalt; n++) {
-                    // check minor(!) allele count
-                    mac = (ac[n] <= an/2) ? ac[n] : an - ac[n];
-                    if (mac >= (size_t) minmac) {
-                        pass = true;
-                        if (!masplitnow) // if we are not splitting MA's here, we can stop
-                            break;
-                    } else if (masplitnow) { // value below threshold and we are splitting MA here
-                        // mark this allele to be filtered later
-                        maaltfilter[n] = true;
-                    }
-                }
-                if (!pass) { // all MAC's are below the threshold
-                    // skip this line
-                    if (!masplitnow) {
-                        nskip++;
-                        continue;
-                    } // else need to continue here for a proper cleanup, all filters were already set to '1'
+            if (!hdr.empty() && !noheader) {
+                h = restoreHeader(hdr, profiles[p], sampleactions, command, groups ? groups->names : vector<string>());
+                if (profiles[p].outputtype == 'b') { // BCF with the header dictionaries for encoding the records
+                    BcfHeader* bh = new BcfHeader(h, chrom, anygq && !profiles[p].sitesonly);
+                    bcfheaders[p] = bh;
+                    h = bh->encode();
+                    tid = bh->contig;
                 }
             }
+            outputs.push_back(new RestoreOutput(profiles[p].outfile, profiles[p].outputtype, h, chrom, tid, csi, pool, shardvariants, shardbytes));
+        }
 
-            // *****************
-            // print VCF line(s)
-            // *****************
-
-            size_t a = 0;
-            do { // for each alt allele, if we split an MA, or only once if not
-
-                if (!masplitnow || !maaltfilter[a]) { // only, if we do not filter this variant
-
-                    // CHROM (chromosome name)
-                    cout << chrom << "\t";
-
-                    // POS, ID, ref allele + alt alleles, QUAL, FILTER if not splitting
-                    cout << pos;
-
-                    if (masplitnow) { // need to print correct alt allele now and then QUAL and FILTER
-                        cout << "\t" << maaltalleles[a];
-                        cout << "\t" << qual; // prints QUAL + FILTER
-                    }
-
-                    // INFO
-                    // print self generated values
-                    float anf = (float) an;
-                    printf("\tAF=%.8f", ac[a]/anf); // AF of first alt allele
-                    if (!masplitnow) {
-                        for (size_t n = 1; n < nalt; n++)
-                            printf(",%.8f", ac[n]/anf); // AF of further alleles if multi-allelic
-                    }
-                    printf(";AC=%lu", ac[a]); // AC of first alt allele
-                    if (!masplitnow) {
-                        for (size_t n = 1; n < nalt; n++)
-                            printf(",%lu", ac[n]); // AC of further alleles if multi-allelic
-                    }
-                    printf(";AN=%lu", an); // AN
-
-                    // original values
-                    if (!rminfo) { // take over all original values -> no MA split possible here
-                        if (info != infoend) { // info is not empty
-                            cout << ";";
-
-                            // find original values of the replaced ones above -> prefix them with "Org"
-                            char* org[3];
-                            org[0] = findInfoField(info, "AF=");
-                            org[1] = findInfoField(info, "AC=");
-                            org[2] = findInfoField(info, "AN=");
-                            // sort...
-                            qsort(org, 3, sizeof(char*), ptrcmp);
-
-                            // print INFO and prefix above fields with 'Org'
-                            char* infoit = info;
-                            for (int i = 0; i < 3; i++) {
-                                if (org[i] != NULL) {
-                                    *(org[i]) = '\0'; // temporarily add null terminator (luckily, we know that we replace an 'A' here...)
-                                    cout << infoit << "OrgA"; // we add the 'A' here, as we replaced it above with the null terminator...
-                                    infoit = org[i]+1; // next char after the null terminator
-                                }
-                            }
-                            // print remainder
-                            cout << infoit;
-                        }
-                    } else if (keepaa) { // remove all original, but keep AAScore
-                        if (aa != NULL) { // AAScore is present (already detected before)
-                            cout << ";AAScore=" << aaval[a]; // print AAScore for current allele
-                            if (!masplitnow) { // print all values for the other alleles as well
-                                for (size_t n = 1; n < nalt; n++)
-                                    cout << "," << aaval[n];
-                            }
-                        }
-                    }
-
-                    // FORMAT
-                    if (parsegq)
-                        cout << "\tGT:GQ\t";
-                    else
-                        cout << "\tGT\t";
-
-                    // genotypes (all buffers end with newline!)
-                    if (masplitnow) {
-                        cout << magts[a];
-//                        if (nalt >= 10) { // there were indices >= 10 which have been replaced by \0
-//                            // print remaining parts after the replacement with \0
-//                            for (char* p : gtparts[a])
-//                                cout << p;
-//                        }
-                    } else
-                        cout << gtstart;
-                    if (!gtparts.empty()) { // there were characters deleted, either from multi-allelic splits with more than 10 alternative alleles, or from making haploid samples
-                        for (char* p : gtparts[a])
-                            cout << p;
-                    }
-
-                    nprint++;
-
-                } else { // this variant is filtered from a multi-allelic split
-                    nskip++;
-                }
-                a++;
-
-            } while(masplitnow && a < nalt); // for each alt allele, if we split an MA, or only once if not
-
-            // cleanup for MA splits
-            if (masplitnow) {
-                for (size_t a = 1; a < nalt; a++) {
-                    if (magts[a])
-                        free(magts[a]);
-                }
+        Restorer* restorer = new Restorer(profiles, chrom, parsegq, ploidymap, sitefilter, bcfheaders, groups);
+        vector<string> outs(profiles.size());
+
+        if (files.size() > 1) {
+            // file-parallel: restore the input files concurrently and print them in file order
+            restoreFiles(files, profiles, chrom, ploidymap, sitefilter, bcfheaders, groups, outputs, nthreads, counters);
+            line = files[0].line; // may have been reallocated
+            len = files[0].len;
+
+        } else if (pool && nline != -1 && (size_t) nline < PARALLEL_SCAN_MINSIZE) {
+            // record-parallel: process batches of lines concurrently and print them in input order
+            vector<Restorer*> restorers(1, restorer);
+            for (unsigned t = 1; t < nthreads; t++)
+                restorers.push_back(new Restorer(profiles, chrom, parsegq, ploidymap, sitefilter, bcfheaders, groups));
+            restoreBatches(*files[0].reader, line, nline, len, restorers, outputs, *pool);
+            for (Restorer* r : restorers) {
+                for (size_t p = 0; p < profiles.size(); p++)
+                    counters[p] += r->counters[p];
+                if (r != restorer)
+                    delete r;
             }
 
-            nhapconflicts_total += nhapconflicts;
-
+        } else {
+            // line by line, very wide lines are scanned in parallel if a pool is present
+            if (pool) {
+                delete restorer;
+                restorer = new Restorer(profiles, chrom, parsegq, ploidymap, sitefilter, bcfheaders, groups, pool);
+            }
+            for (; nline != -1; nline = files[0].reader->getline(&line, &len)) {
+                restorer->processLine(line, nline, outs.data());
+                size_t outsize = 0;
+                for (const string& o : outs)
+                    outsize += o.size();
+                if (outsize >= OUTBUFSIZE)
+                    writeOuts(outs, outputs);
+            }
+            writeOuts(outs, outputs);
+            counters = restorer->counters;
         }
 
-        cout << flush;
-        free(ac);
+        for (size_t p = 0; p < outputs.size(); p++) {
+            outputs[p]->close();
+            if (shardvariants || shardbytes)
+                cerr << "Shards written for " << profiles[p].outfile << ": " << outputs[p]->numShards() << " (see " << outputs[p]->manifestName() << ")" << endl;
+            delete outputs[p];
+        }
+        for (const BcfHeader* bh : bcfheaders)
+            if (bh)
+                delete bh;
+        delete restorer;
+        if (sitefilter)
+            delete sitefilter;
+        if (groups)
+            delete groups;
 
     } // END contains data
 
-    cerr << "Number of read variants: " << nread << endl;
-    cerr << "Number of printed variants: " << nprint << endl;
-    cerr << "Number of splitted variants: " << nsplit << endl;
-    cerr << "Number of skipped variants (after split): " << nskip << endl;
+    for (size_t p = 0; p < profiles.size(); p++) {
+        if (named)
+            cerr << "Profile " << profiles[p].name << " -> " << profiles[p].outfile << ":" << endl;
+        printCounters(counters[p]);
+    }
     cerr << "Line buffer size: " << len;
     if (len != lenstart)
         cerr << " -> changed!!";
     cerr << endl;
-    if (nhapconflicts_total) {
-        cerr << "Conversion to haploid encountered conflicts: " << nhapconflicts_total << endl;
+    for (size_t p = 0; p < profiles.size(); p++) {
+        if (counters[p].nhapconflicts) {
+            cerr << "Conversion to haploid encountered conflicts: " << counters[p].nhapconflicts;
+            if (named)
+                cerr << " (" << profiles[p].name << ")";
+            cerr << endl;
+        }
     }
 
+    for (size_t i = 0; i < files.size(); i++) {
+        delete files[i].reader;
+        if (i > 0)
+            free(files[i].line);
+    }
     free(line);
+    if (pool)
+        delete pool;
 
 }
 
@@ -22,8 +22,50 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "bcfreader.h"
+
 #define BUFSIZE 1073741824
 
+// stores a header line, descriptions of FORMAT fields that are not extracted (all except GT and GQ if requested) are skipped
+static void storeHeaderLine(const char* line, size_t nh, int parsegq, char** hdr, size_t* hdrlen, size_t* hdrcap, size_t* hdrchrom) {
+    if (strncmp(line, "##FORMAT=<ID=", 13) == 0) {
+        const char* id = line+13;
+        int keep = strncmp(id, "GT", 2) == 0 || (parsegq && strncmp(id, "GQ", 2) == 0);
+        if (!keep || (id[2] != ',' && id[2] != '>'))
+            return;
+    }
+    if (strncmp(line, "#CHROM", 6) == 0)
+        *hdrchrom = *hdrlen;
+    if (*hdrlen + nh > *hdrcap) {
+        *hdrcap = 2 * (*hdrlen + nh);
+        *hdr = realloc(*hdr, *hdrcap);
+    }
+    memcpy(*hdr + *hdrlen, line, nh);
+    *hdrlen += nh;
+}
+
+// prints the first line of the extraction (chromosome and <args>) followed by the stored header
+static void printHeader(const char* chrom, int argc, char** argv, const char* hdr, size_t hdrlen, size_t hdrchrom) {
+    fputs(chrom, stdout); // print chromosome name
+
+    // print <args> after chromosome, using ';' as separator
+    for (int i=1; i < argc; i++) {
+        printf(";%s", argv[i]);
+    }
+    printf("\n");
+
+    // print the header: all lines start with '#', so restorevcf can distinguish them from the data
+    if (hdrlen) {
+        fwrite(hdr, 1, hdrchrom, stdout);
+        // add header line indicating the use of this tool
+        printf("##vcffilter_command=");
+        for (int i = 0; i < argc; i++)
+            printf("%s ", argv[i]);
+        printf("\n");
+        fwrite(hdr + hdrchrom, 1, hdrlen - hdrchrom, stdout);
+    }
+}
+
 int main (int argc, char **argv) {
 
     // parse args
@@ -46,15 +88,46 @@ int main (int argc, char **argv) {
     char *line = malloc(len*sizeof(char));
     size_t nline = 0;
 
-    // skip header and print chromosome to output
+    // store the header (printed after the chromosome) and print chromosome to output
+    char* hdr = NULL; // header lines
+    size_t hdrlen = 0;
+    size_t hdrcap = 0;
+    size_t hdrchrom = 0; // beginning of the #CHROM line in hdr
     size_t nh;
+
+    // BCF input: the genotypes are decoded directly into the extraction, other FORMAT fields are not touched
+    if (bcfDetect(stdin)) {
+        BcfReader r;
+        if (bcfOpen(&r, stdin) != 0)
+            exit(EXIT_FAILURE);
+        for (char* l = r.hdr; l < r.hdr + r.hdrlen; ) {
+            char* lend = strchr(l, '\n') + 1; // the header text ends with a newline
+            storeHeaderLine(l, lend - l, parsegq, &hdr, &hdrlen, &hdrcap, &hdrchrom);
+            l = lend;
+        }
+        if (bcfReadRecord(&r) == 0) { // contains data
+            printHeader(bcfChrom(&r), argc, argv, hdr, hdrlen, hdrchrom);
+            const char* keys[2] = {"GT", "GQ"};
+            BcfStr out = {line, 0, len}; // use the line buffer
+            do {
+                out.l = 0;
+                bcfFormatSite(&r, &out, 0); // all fields from position to INFO
+                bcfFormatSamples(&r, &out, keys, parsegq ? 2 : 1, NULL, 0);
+                fwrite(out.s, 1, out.l, stdout);
+                printf("\n"); // newline at the end
+                nline++;
+            } while (bcfReadRecord(&r) == 0);
+            line = out.s;
+            len = out.m;
+        }
+        bcfClose(&r);
+        goto finish;
+    }
+
     while((nh = getline(&line, &len, stdin)) != -1) {
-        if (nh > 0 && *line != '#') { // just found the first line after the header
-            // copy chromosome name
-            char* chromend = strchr(line, '\t');
-            *chromend = '\0'; // null terminate chromosome name
-            fputs(line, stdout); // print chromosome name
-            *chromend = '\t'; // restore tab character for further processing below
+        if (nh > 0 && *line == '#') { // header line
+            storeHeaderLine(line, nh, parsegq, &hdr, &hdrlen, &hdrcap, &hdrchrom);
+        } else if (nh > 0) { // just found the first line after the header
             break;
         }
     }
@@ -64,11 +137,11 @@ int main (int argc, char **argv) {
         goto finish;
     }
 
-    // print <args> after chromosome, using ';' as separator
-    for (int i=1; i < argc; i++) {
-        printf(";%s", argv[i]);
-    }
-    printf("\n");
+    // copy chromosome name
+    char* chromend = strchr(line, '\t');
+    *chromend = '\0'; // null terminate chromosome name
+    printHeader(line, argc, argv, hdr, hdrlen, hdrchrom);
+    *chromend = '\t'; // restore tab character for further processing below
 
     // parse rest of file
     do {
@@ -215,6 +288,7 @@ finish:
         fprintf(stderr, "\n");
 
     free(line);
+    free(hdr);
 
 }
 